@@ -0,0 +1,122 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <iostream>
+#include <iomanip>
+#include <distributions/random.hpp>
+#include <distributions/clustering.hpp>
+#include <distributions/timers.hpp>
+
+using namespace distributions;  // NOLINT(*)
+
+// Gibbs-style reassignment over a fixed clustering: the hot path of the
+// 32-bit and 64-bit Clustering instantiations should run at the same speed.
+template<class count_t>
+double speedtest(size_t sample_size, size_t iters, rng_t & rng) {
+    typedef typename Clustering<count_t>::PitmanYor Model;
+    Model model;
+    model.alpha = 1.f;
+    model.d = 0.2f;
+
+    std::vector<count_t> assignments =
+        model.sample_assignments(sample_size, rng);
+    typename Model::Mixture mixture;
+    for (count_t groupid : assignments) {
+        if (mixture.counts().size() <= size_t(groupid)) {
+            mixture.counts().resize(groupid + 1, 0);
+        }
+        ++mixture.counts()[groupid];
+    }
+    mixture.counts().push_back(0);
+    mixture.init(model);
+
+    VectorFloat scores;
+    int64_t time = -current_time_us();
+    for (size_t i = 0; i < iters; ++i) {
+        const size_t pos = i % sample_size;
+        size_t groupid = assignments[pos];
+        const size_t group_count = mixture.counts().size();
+        if (mixture.remove_value(model, groupid)) {
+            for (auto & other : assignments) {
+                if (size_t(other) == group_count - 1) {
+                    other = groupid;
+                }
+            }
+        }
+        scores.resize(mixture.counts().size());
+        mixture.score_value(model, scores);
+        groupid = sample_from_scores_overwrite(rng, scores);
+        mixture.add_value(model, groupid);
+        assignments[pos] = groupid;
+    }
+    time += current_time_us();
+    return iters / (time * 1e-6);
+}
+
+// Bulk-add counts to a few groups until sample_size exceeds 32 bits.
+template<class count_t>
+void scaletest(size_t sample_size, size_t group_count) {
+    typedef typename Clustering<count_t>::PitmanYor Model;
+    Model model;
+    model.alpha = 1.f;
+    model.d = 0.2f;
+
+    typename Model::Mixture mixture;
+    mixture.counts().push_back(0);
+    mixture.init(model);
+    const count_t chunk = 1 << 26;
+    for (size_t added = 0; added < sample_size; added += chunk) {
+        const size_t groupid = (added / chunk) % group_count;
+        mixture.add_value(model, std::min(groupid, mixture.counts().size() - 1),
+            std::min<size_t>(chunk, sample_size - added));
+    }
+
+    std::cout << "sample_size = " << mixture.sample_size() <<
+        ", group_count = " << mixture.counts().size() - 1 <<
+        ", score = " << mixture.score_data(model) << '\n';
+}
+
+int main() {
+    rng_t rng;
+    std::cout << "sample_size" << '\t' <<
+        "int32 steps/sec" << '\t' << "int64 steps/sec" << '\n';
+    for (size_t exponent = 3; exponent <= 6; ++exponent) {
+        size_t sample_size = size_t(round(pow(10, exponent)));
+        size_t iters = 100000;
+        double speed32 = speedtest<int32_t>(sample_size, iters, rng);
+        double speed64 = speedtest<int64_t>(sample_size, iters, rng);
+        std::cout << sample_size << '\t' <<
+            std::right << std::setw(15) << std::fixed <<
+            std::setprecision(1) << speed32 << '\t' <<
+            std::right << std::setw(15) << std::fixed <<
+            std::setprecision(1) << speed64 << '\n';
+    }
+
+    scaletest<int64_t>(10000000000ULL, 100);
+
+    return 0;
+}
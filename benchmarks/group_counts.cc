@@ -0,0 +1,107 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <iostream>
+#include <iomanip>
+#include <typeinfo>
+#include <distributions/models/bb.hpp>
+#include <distributions/models/dd.hpp>
+#include <distributions/models/dpd.hpp>
+#include <distributions/models/gp.hpp>
+#include <distributions/models/bnb.hpp>
+#include <distributions/models/nich.hpp>
+#include <distributions/timers.hpp>
+
+using namespace distributions;  // NOLINT(*)
+
+rng_t rng;
+
+// Group-level hot path at large counts: build a group of the given size
+// with add_repeated_value, then time remove_value + score_value + add_value
+// cycles.  Build with and without DIST_64BIT to compare count_t widths.
+template<class Model>
+void speedtest(
+        const typename Model::Shared & shared,
+        count_t count,
+        size_t iters) {
+    typename Model::Group group;
+    group.init(shared, rng);
+    std::vector<typename Model::Value> values;
+    for (size_t i = 0; i < 64; ++i) {
+        values.push_back(group.sample_value(shared, rng));
+    }
+    for (const auto & value : values) {
+        group.add_repeated_value(shared, value, count / values.size(), rng);
+    }
+
+    float total = 0;
+    int64_t time = -current_time_us();
+    for (size_t i = 0; i < iters; ++i) {
+        const auto & value = values[i % values.size()];
+        group.remove_value(shared, value, rng);
+        total += group.score_value(shared, value, rng);
+        group.add_value(shared, value, rng);
+    }
+    time += current_time_us();
+    const double rate = iters * 1e0 / time;
+
+    std::cout <<
+        count << '\t' <<
+        std::right << std::setw(7) << std::fixed << std::setprecision(2) <<
+        rate << '\t' <<
+        std::right << std::setw(12) << std::setprecision(4) <<
+        total / iters << '\n';
+}
+
+template<class Model>
+void speedtests() {
+    std::cout <<
+        demangle(typeid(typename Model::Shared).name()) << '\n' <<
+        "Count" << '\t' <<
+        "Cycles/us" << '\t' <<
+        "Mean score" << '\n';
+
+    auto const shared = Model::Shared::EXAMPLE();
+    // past 2^32 only with 64-bit count_t
+    const int64_t max_count =
+        sizeof(count_t) == 8 ? 10000000000LL : 1000000000LL;
+    for (int64_t count = 100; count <= max_count; count *= 10) {
+        speedtest<Model>(shared, count, 1000000);
+    }
+}
+
+int main() {
+    std::cout << "sizeof(count_t) = " << sizeof(count_t) << '\n';
+    speedtests<BetaBernoulli>();
+    speedtests<DirichletDiscrete<4>>();
+    speedtests<DirichletProcessDiscrete>();
+    speedtests<GammaPoisson>();
+    speedtests<BetaNegativeBinomial>();
+    speedtests<NormalInverseChiSq>();
+
+    return 0;
+}
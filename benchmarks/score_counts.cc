@@ -69,12 +69,44 @@ size_t speedtest(size_t size, size_t iters, float alpha, float d) {
 
     double time_sec = time * 1e-6;
     double scores_per_sec = iters / time_sec;
+
+    const Clustering<int>::CountHistogram histogram(counts);
+    const size_t hist_iters = iters * 10;
+    int64_t hist_time = -current_time_us();
+    for (size_t i = 0; i < hist_iters; ++i) {
+        bogus += model.score_histogram(histogram);
+    }
+    hist_time += current_time_us();
+    double hist_scores_per_sec = hist_iters / (hist_time * 1e-6);
+
+    const size_t grid_size = 32;
+    std::vector<float> alphas(grid_size);
+    std::vector<float> ds(grid_size);
+    for (size_t i = 0; i < grid_size; ++i) {
+        alphas[i] = alpha * pow(2.0, (i - grid_size / 2.0) / 4);
+        ds[i] = (i + 0.5f) / grid_size;
+    }
+    std::vector<float> grid_scores;
+    int64_t grid_time = -current_time_us();
+    Clustering<int>::PitmanYor::score_histogram_grid(
+        histogram,
+        alphas,
+        ds,
+        grid_scores);
+    grid_time += current_time_us();
+    double grid_scores_per_sec = grid_scores.size() / (grid_time * 1e-6);
+    bogus += grid_scores[0];
+
     std::cout <<
         size << '\t' <<
         std::right << std::setw(6) << std::fixed << std::setprecision(1) <<
         max(counts) << '\t' <<
         std::right << std::setw(12) << std::fixed << std::setprecision(1) <<
-        scores_per_sec << '\n';
+        scores_per_sec << '\t' <<
+        std::right << std::setw(12) << std::fixed << std::setprecision(1) <<
+        hist_scores_per_sec << '\t' <<
+        std::right << std::setw(12) << std::fixed << std::setprecision(1) <<
+        grid_scores_per_sec << '\n';
 
     return bogus;
 }
@@ -83,7 +115,8 @@ int main(int argc, char ** argv) {
     float alpha = (argc > 1) ? atof(argv[1]) : 1.0f;
     float d = (argc > 2) ? atof(argv[2]) : 0.2f;
 
-    std::cout << "size" << '\t' << "max cat" << '\t' << "scores/sec";
+    std::cout << "size" << '\t' << "max cat" << '\t' << "scores/sec" <<
+        '\t' << "hist scores/sec" << '\t' << "grid scores/sec";
     std::cout << " (alpha = " << alpha << ", d = " << d << ")\n";
 
     size_t min_exponent = 3;
@@ -0,0 +1,126 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <iostream>
+#include <iomanip>
+#include <typeinfo>
+#include <distributions/models/bb.hpp>
+#include <distributions/models/bnb.hpp>
+#include <distributions/models/dd.hpp>
+#include <distributions/models/gp.hpp>
+#include <distributions/timers.hpp>
+
+using namespace distributions;  // NOLINT(*)
+
+rng_t rng;
+
+// scales hyperparameters, as a hyperparameter grid search would
+inline void perturb(BetaBernoulli::Shared & shared, float scale) {
+    shared.alpha *= scale;
+}
+
+inline void perturb(GammaPoisson::Shared & shared, float scale) {
+    shared.alpha *= scale;
+}
+
+inline void perturb(BetaNegativeBinomial::Shared & shared, float scale) {
+    shared.alpha *= scale;
+}
+
+inline void perturb(DirichletDiscrete<16>::Shared & shared, float scale) {
+    for (int i = 0; i < shared.dim; ++i) {
+        shared.alphas[i] *= scale;
+    }
+}
+
+// Times MixtureDataScorer::score_data with fixed hyperparameters, which
+// reuse the Shared lgamma table, and with hyperparameters that change on
+// every call, as when scoring a hyperparameter grid.
+template<class Model>
+void speedtest(size_t group_count, size_t iters) {
+    const auto base = Model::Shared::EXAMPLE();
+    auto shared = base;
+    typename Model::Mixture mixture;
+    mixture.groups().resize(group_count);
+    for (auto & group : mixture.groups()) {
+        group.init(shared, rng);
+    }
+    for (size_t i = 0; i < 100 * group_count; ++i) {
+        auto & group = mixture.groups(sample_int(rng, 0, group_count - 1));
+        group.add_value(shared, group.sample_value(shared, rng), rng);
+    }
+    mixture.init(shared, rng);
+
+    float total = 0;
+    int64_t time = -current_time_us();
+    for (size_t i = 0; i < iters; ++i) {
+        total += mixture.score_data(shared, rng);
+    }
+    time += current_time_us();
+    const double fixed_time = time * 1e0 / iters;
+
+    time = -current_time_us();
+    for (size_t i = 0; i < iters; ++i) {
+        shared = base;
+        perturb(shared, 1 + (i % 100) * 0.01f);
+        total += mixture.score_data(shared, rng);
+    }
+    time += current_time_us();
+    const double changing_time = time * 1e0 / iters;
+
+    std::cout <<
+        group_count << '\t' <<
+        std::right << std::setw(7) << std::fixed << std::setprecision(2) <<
+        fixed_time << '\t' <<
+        std::right << std::setw(7) << std::fixed << std::setprecision(2) <<
+        changing_time << '\t' <<
+        std::right << std::setw(12) << std::setprecision(4) <<
+        total / iters << '\n';
+}
+
+template<class Model>
+void speedtests() {
+    std::cout <<
+        demangle(typeid(typename Model::Shared).name()) << '\n' <<
+        "Groups" << '\t' <<
+        "Fixed" << '\t' <<
+        "Changing (us/call)" << '\t' <<
+        "Mean score" << '\n';
+
+    for (int group_count = 10; group_count <= 10000; group_count *= 10) {
+        speedtest<Model>(group_count, 100000 / group_count);
+    }
+}
+
+int main() {
+    speedtests<BetaBernoulli>();
+    speedtests<BetaNegativeBinomial>();
+    speedtests<DirichletDiscrete<16>>();
+    speedtests<GammaPoisson>();
+
+    return 0;
+}
@@ -28,6 +28,7 @@
 #include <iostream>
 #include <iomanip>
 #include <distributions/random.hpp>
+#include <distributions/special.hpp>
 #include <distributions/timers.hpp>
 #include <distributions/aligned_allocator.hpp>
 #include <distributions/vendor/fmath.hpp>
@@ -294,6 +295,43 @@ struct mkl_lgamma_nu {
 #endif  // USE_INTEL_MKL
 
 
+// n cycles through the short products that are evaluated directly
+struct scalar_rising {
+    static const char * name() { return "scalar"; }
+    static const char * fun() { return "rising"; }
+
+    static void inplace(Vector & values) {
+        const size_t size = values.size();
+        float * __restrict__ data = & values[0];
+        for (size_t i = 0; i < size; ++i) {
+            data[i] = log_rising_factorial(data[i], i % 16);
+        }
+    }
+};
+
+struct batch_rising {
+    static const char * name() { return "batch"; }
+    static const char * fun() { return "rising"; }
+
+    static void inplace(Vector & values) {
+        const size_t size = values.size();
+        static std::vector<size_t> counts_;
+        static Vector temp_;
+        counts_.resize(size);
+        temp_.resize(size);
+        for (size_t i = 0; i < size; ++i) {
+            counts_[i] = i % 16;
+        }
+        vector_log_rising_factorial(
+            size,
+            & values[0],
+            & counts_[0],
+            & temp_[0]);
+        values.swap(temp_);
+    }
+};
+
+
 template<class impl>
 void speedtest(size_t size, size_t iters) {
     rng_t rng;
@@ -386,5 +424,10 @@ int main() {
 #endif  // USE_INTEL_MKL
     speedtest<eric_lgamma_nu>(size, iters);
 
+    std::cout << std::endl;
+
+    speedtest<scalar_rising>(size, iters);
+    speedtest<batch_rising>(size, iters);
+
     return 0;
 }
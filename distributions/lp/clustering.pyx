@@ -38,8 +38,7 @@ from distributions.mixins import SharedIoMixin
 
 
 cdef extern from 'distributions/mixture.hpp':
-    cppclass IdSet \
-            "std::unordered_set<size_t, distributions::TrivialHash<size_t>>":
+    cppclass IdSet "distributions::DenseIdSet":
         cppclass iterator "const_iterator":
             size_t & operator*()
             iterator operator++() nogil
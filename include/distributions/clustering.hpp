@@ -27,6 +27,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
@@ -39,7 +40,7 @@
 namespace distributions {
 
 // This is explicitly instantiated for:
-// - int32_t
+// - int32_t, int64_t, uint32_t, uint64_t
 // To add datatypes, edit the bottom of src/clustering.cc
 template<class count_t>
 struct Clustering {
@@ -52,6 +53,79 @@ static std::vector<count_t> count_assignments(
         const Assignments & assignments);
 
 
+// --------------------------------------------------------------------------
+// Count Histogram
+//
+// This tracks how many groups have each size (including empty groups, as
+// size zero), so that priors can be scored in time linear in the number
+// of distinct group sizes rather than the number of groups.  Sizes are
+// sparse: a few large groups can be far larger than all the others.
+
+class CountHistogram {
+ public:
+    typedef std::unordered_map<count_t, count_t, TrivialHash<count_t>> Map;
+
+    CountHistogram() : group_count_(0), sample_size_(0) {}
+
+    explicit CountHistogram(const std::vector<count_t> & counts) {
+        init(counts);
+    }
+
+    // maps each size to its nonzero number of groups
+    const Map & multiplicities() const { return multiplicities_; }
+    size_t group_count() const { return group_count_; }
+    size_t sample_size() const { return sample_size_; }
+
+    count_t multiplicity(count_t size) const {
+        auto i = multiplicities_.find(size);
+        return i == multiplicities_.end() ? 0 : i->second;
+    }
+
+    size_t empty_group_count() const { return multiplicity(0); }
+
+    void init(const std::vector<count_t> & counts) {
+        multiplicities_.clear();
+        group_count_ = 0;
+        sample_size_ = 0;
+        for (count_t count : counts) {
+            add_group(count);
+        }
+    }
+
+    void add_group(count_t size = 0) {
+        ++multiplicities_[size];
+        group_count_ += 1;
+        sample_size_ += size;
+    }
+
+    void remove_group(count_t size = 0) {
+        _decrement(size);
+        group_count_ -= 1;
+        sample_size_ -= size;
+    }
+
+    void resize_group(count_t old_size, count_t new_size) {
+        _decrement(old_size);
+        ++multiplicities_[new_size];
+        sample_size_ += new_size;
+        sample_size_ -= old_size;
+    }
+
+ private:
+    void _decrement(count_t size) {
+        auto i = multiplicities_.find(size);
+        DIST_ASSERT2(i != multiplicities_.end(), "missing size: " << size);
+        if (--(i->second) == 0) {
+            multiplicities_.erase(i);
+        }
+    }
+
+    Map multiplicities_;
+    size_t group_count_;
+    size_t sample_size_;
+};
+
+
 // --------------------------------------------------------------------------
 // Pitman-Yor Model
 
@@ -75,9 +149,27 @@ struct PitmanYor {
             count_t size,
             rng_t & rng) const;
 
+    // Continues the Chinese restaurant process from the given group sizes,
+    // updating counts in place.  Empty groups are never chosen; new groups
+    // are appended to counts.  Costs O(log(counts.size())) per row.
+    std::vector<count_t> sample_posterior_assignments(
+            std::vector<count_t> & counts,
+            count_t size,
+            rng_t & rng) const;
+
     float score_counts(
             const std::vector<count_t> & counts) const;
 
+    // equal to score_counts, up to rounding
+    float score_histogram(const CountHistogram & histogram) const;
+
+    // scores[i * ds.size() + j] = score of (alphas[i], ds[j]), in parallel
+    static void score_histogram_grid(
+            const CountHistogram & histogram,
+            const std::vector<float> & alphas,
+            const std::vector<float> & ds,
+            std::vector<float> & scores);
+
     float score_add_value(
             count_t group_size,
             count_t nonempty_group_count,
@@ -148,8 +240,13 @@ struct PitmanYor {
             return driver_.sample_size();
         }
 
+        const CountHistogram & histogram() const {
+            return histogram_;
+        }
+
         void init(const Model & model) {
             driver_.init(model);
+            histogram_.init(driver_.counts());
             const size_t group_count = driver_.counts().size();
             shifted_scores_.resize(group_count);
             for (size_t i = 0; i < group_count; ++i) {
@@ -164,10 +261,13 @@ struct PitmanYor {
                 const Model & model,
                 size_t groupid,
                 count_t count = 1) {
+            const count_t old_size = counts(groupid);
             const bool add_group = driver_.add_value(model, groupid, count);
+            histogram_.resize_group(old_size, old_size + count);
 
             if (DIST_UNLIKELY(add_group)) {
                 shifted_scores_.packed_add();
+                histogram_.add_group();
                 _update_empty_groups(model);
             }
             _update_nonempty_group(model, groupid);
@@ -179,11 +279,14 @@ struct PitmanYor {
                 const Model & model,
                 size_t groupid,
                 count_t count = 1) {
+            const count_t old_size = counts(groupid);
             const bool remove_group =
                 driver_.remove_value(model, groupid, count);
+            histogram_.resize_group(old_size, old_size - count);
 
             if (DIST_UNLIKELY(remove_group)) {
                 shifted_scores_.packed_remove(groupid);
+                histogram_.remove_group();
                 _update_empty_groups(model);
             } else {
                 _update_nonempty_group(model, groupid);
@@ -208,7 +311,7 @@ struct PitmanYor {
         }
 
         float score_data(const Model & model) const {
-            return driver_.score_data(model);
+            return model.score_histogram(histogram_);
         }
 
      private:
@@ -230,6 +333,7 @@ struct PitmanYor {
         }
 
         MixtureDriver<PitmanYor, count_t> driver_;
+        CountHistogram histogram_;
         VectorFloat shifted_scores_;
     };
 
@@ -261,6 +365,9 @@ struct LowEntropy {
 
     float score_counts(const std::vector<count_t> & counts) const;
 
+    // equal to score_counts, up to rounding
+    float score_histogram(const CountHistogram & histogram) const;
+
     float score_add_value(
             count_t group_size,
             count_t nonempty_group_count,
@@ -278,16 +385,8 @@ struct LowEntropy {
                 score += _approximate_postpred_correction(sample_size + 1);
             }
             return score;
-        }
-
-        // see `python derivations/clustering.py fastlog`
-        const count_t very_large = 10000;
-        float bigger = 1.f + group_size;
-        if (group_size > very_large) {
-            return 1.f + fast_log(bigger);
         } else {
-            return fast_log(bigger / group_size) * group_size
-                 + fast_log(bigger);
+            return _score_add_value_nonempty(group_size);
         }
     }
 
@@ -310,9 +409,141 @@ struct LowEntropy {
 
     float log_partition_function(count_t sample_size) const;
 
-    typedef MixtureDriver<LowEntropy, count_t> Mixture;
+    // HACK gcc doesn't want Mixture defined outside of LowEntropy
+    class CachedMixture {
+     public:
+        typedef LowEntropy Model;
+        typedef typename MixtureDriver<LowEntropy, count_t>::IdSet IdSet;
+
+        std::vector<count_t> & counts() {
+            return driver_.counts();
+        }
+
+        const std::vector<count_t> & counts() const {
+            return driver_.counts();
+        }
+
+        count_t counts(size_t groupid) const {
+            return driver_.counts(groupid);
+        }
+
+        const IdSet & empty_groupids() const {
+            return driver_.empty_groupids();
+        }
+
+        size_t sample_size() const {
+            return driver_.sample_size();
+        }
+
+        const CountHistogram & histogram() const {
+            return histogram_;
+        }
+
+        void init(const Model & model) {
+            driver_.init(model);
+            histogram_.init(driver_.counts());
+            const size_t group_count = driver_.counts().size();
+            scores_.resize(group_count);
+            for (size_t i = 0; i < group_count; ++i) {
+                if (driver_.counts(i)) {
+                    _update_nonempty_group(model, i);
+                }
+            }
+        }
+
+        bool add_value(
+                const Model & model,
+                size_t groupid,
+                count_t count = 1) {
+            const count_t old_size = counts(groupid);
+            const bool add_group = driver_.add_value(model, groupid, count);
+            histogram_.resize_group(old_size, old_size + count);
+
+            if (DIST_UNLIKELY(add_group)) {
+                scores_.packed_add();
+                histogram_.add_group();
+            }
+            _update_nonempty_group(model, groupid);
+
+            return add_group;
+        }
+
+        bool remove_value(
+                const Model & model,
+                size_t groupid,
+                count_t count = 1) {
+            const count_t old_size = counts(groupid);
+            const bool remove_group =
+                driver_.remove_value(model, groupid, count);
+            histogram_.resize_group(old_size, old_size - count);
+
+            if (DIST_UNLIKELY(remove_group)) {
+                scores_.packed_remove(groupid);
+                histogram_.remove_group();
+            } else {
+                _update_nonempty_group(model, groupid);
+            }
+
+            return remove_group;
+        }
+
+        // Nonempty scores depend only on group size and are cached;
+        // the empty-group score depends on sample_size and is patched in.
+        void score_value(const Model & model, AlignedFloats scores) const {
+            if (DIST_DEBUG_LEVEL >= 1) {
+                DIST_ASSERT_EQ(scores.size(), counts().size());
+            }
+
+            const size_t size = counts().size();
+            const float * __restrict__ in = VectorFloat_data(scores_);
+            float * __restrict__ out = VectorFloat_data(scores);
+            std::copy(in, in + size, out);
+
+            const count_t empty_group_count = empty_groupids().size();
+            const count_t nonempty_group_count = size - empty_group_count;
+            const float empty_score = model.score_add_value(
+                0,
+                nonempty_group_count,
+                sample_size(),
+                empty_group_count);
+            for (size_t i : empty_groupids()) {
+                out[i] = empty_score;
+            }
+        }
+
+        float score_data(const Model & model) const {
+            return model.score_histogram(histogram_);
+        }
+
+     private:
+        void _update_nonempty_group(const Model & model, size_t groupid) {
+            auto const group_size = counts(groupid);
+            DIST_ASSERT2(group_size, "expected nonempty group");
+            scores_[groupid] = model._score_add_value_nonempty(group_size);
+        }
+
+        MixtureDriver<LowEntropy, count_t> driver_;
+        CountHistogram histogram_;
+        VectorFloat scores_;
+    };
+
+    // The uncached version is useful for debugging
+    // typedef MixtureDriver<LowEntropy, count_t> Mixture;
+    typedef CachedMixture Mixture;
 
  private:
+    float _score_add_value_nonempty(count_t group_size) const {
+        // see `python derivations/clustering.py fastlog`
+        const count_t very_large = 10000;
+        float bigger = 1.f + group_size;
+        if (group_size > very_large) {
+            return 1.f + fast_log(bigger);
+        } else {
+            return fast_log(bigger / group_size) * group_size
+                 + fast_log(bigger);
+        }
+    }
+
     // ad hoc approximation,
     // see `python derivations/clustering.py postpred`
     // see `python derivations/clustering.py approximations`
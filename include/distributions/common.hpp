@@ -27,6 +27,7 @@
 
 #pragma once
 
+#include <stdint.h>
 #include <string>
 #include <iostream>
 #include <sstream>
@@ -135,6 +136,16 @@ inline std::string demangle(const char * name) {
 
 enum { SYNCHRONIZE_ENTROPY_FOR_UNIT_TESTING = 1 };
 
+// Counts of observed values in model groups.  These are 32-bit by default;
+// define DIST_64BIT to count datasets with more than 2^31 rows.
+#ifdef DIST_64BIT
+typedef int64_t count_t;
+typedef uint64_t ucount_t;
+#else  // DIST_64BIT
+typedef int32_t count_t;
+typedef uint32_t ucount_t;
+#endif  // DIST_64BIT
+
 int foo();
 
 }   // namespace distributions
@@ -0,0 +1,205 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <distributions/common.hpp>
+#include <distributions/random.hpp>
+#include <distributions/parallel.hpp>
+#include <distributions/io/snapshot.hpp>
+
+namespace distributions {
+
+// --------------------------------------------------------------------------
+// Columnar Datasets
+//
+// A dataset is a snapshot file (see snapshot.hpp) with sections
+//
+//   assignments      uint32_t groupid of each row
+//   <name>.values    one scalar value per row, e.g. int, uint32_t or float
+//   <name>.missing   optional bitmap of uint64_t words, where bit i % 64
+//                    of word i / 64 is set if row i is missing
+//
+// so columns are used in place from a memory map.  To build a many-feature
+// model, run one dataset_build_mixture per column via parallel_tasks.
+
+template<class T>
+struct DatasetColumn {
+    SnapshotArray<T> values;
+    SnapshotArray<uint64_t> missing;  // empty if no value is missing
+
+    size_t size() const { return values.size; }
+    bool is_missing(size_t row) const {
+        return missing.size and ((missing[row / 64] >> (row % 64)) & 1);
+    }
+};
+
+inline size_t dataset_missing_size(size_t row_count) {
+    return (row_count + 63) / 64;
+}
+
+template<class T>
+inline void dataset_add_column(
+        SnapshotWriter & writer,
+        const std::string & name,
+        const T * values,
+        size_t row_count,
+        const uint64_t * missing = nullptr) {
+    writer.add_array(name + ".values", values, row_count);
+    if (missing) {
+        writer.add_array(
+            name + ".missing",
+            missing,
+            dataset_missing_size(row_count));
+    }
+}
+
+inline SnapshotArray<uint32_t> dataset_assignments(
+        const SnapshotReader & reader) {
+    return reader.array<uint32_t>("assignments");
+}
+
+template<class T>
+inline DatasetColumn<T> dataset_column(
+        const SnapshotReader & reader,
+        const std::string & name) {
+    DatasetColumn<T> column;
+    column.values = reader.array<T>(name + ".values");
+    if (reader.has(name + ".missing")) {
+        column.missing = reader.array<uint64_t>(name + ".missing");
+        DIST_ASSERT_EQ(
+            column.missing.size,
+            dataset_missing_size(column.size()));
+    } else {
+        column.missing.data = nullptr;
+        column.missing.size = 0;
+    }
+    return column;
+}
+
+namespace detail {
+
+// integer values are counted first, then added once per distinct value
+template<class Shared, class Group, class Value>
+inline void dataset_add_values(
+        const Shared & shared,
+        Group & group,
+        Value * begin,
+        Value * end,
+        rng_t & rng,
+        std::true_type) {
+    std::sort(begin, end);
+    while (begin != end) {
+        const Value value = * begin;
+        const Value * run_end = std::upper_bound(begin, end, value);
+        const count_t count = run_end - begin;
+        group.add_repeated_value(shared, value, count, rng);
+        begin += count;
+    }
+}
+
+// real values are added in row order
+template<class Shared, class Group, class Value>
+inline void dataset_add_values(
+        const Shared & shared,
+        Group & group,
+        Value * begin,
+        Value * end,
+        rng_t & rng,
+        std::false_type) {
+    for (; begin != end; ++begin) {
+        group.add_value(shared, * begin, rng);
+    }
+}
+
+}  // namespace detail
+
+// Builds the groups of a mixture from one column; every assignment must be
+// less than group_count.  Present values are first bucketed by group, then
+// groups are built on the thread pool, each with its own rng_stream, so
+// each group sees the same values and random numbers for any thread count.
+template<class Mixture>
+inline void dataset_build_mixture(
+        const typename Mixture::Shared & shared,
+        const SnapshotArray<uint32_t> & assignments,
+        const DatasetColumn<typename Mixture::Value> & column,
+        size_t group_count,
+        Mixture & mixture,
+        rng_t & rng) {
+    typedef typename Mixture::Value Value;
+    static_assert(
+        std::is_arithmetic<Value>::value,
+        "dataset columns hold scalar values");
+    const size_t row_count = assignments.size;
+    DIST_ASSERT_EQ(column.size(), row_count);
+
+    // bucket present values by group, as in a counting sort
+    std::vector<size_t> offsets(group_count + 1, 0);
+    for (size_t row = 0; row < row_count; ++row) {
+        if (not column.is_missing(row)) {
+            const uint32_t groupid = assignments[row];
+            DIST_ASSERT(groupid < group_count, "bad groupid: " << groupid);
+            ++offsets[groupid + 1];
+        }
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    // not std::vector, which packs bools
+    std::unique_ptr<Value[]> values(new Value[offsets.back()]);
+    std::vector<size_t> ends(offsets.begin(), offsets.end() - 1);
+    for (size_t row = 0; row < row_count; ++row) {
+        if (not column.is_missing(row)) {
+            values[ends[assignments[row]]++] = column.values[row];
+        }
+    }
+
+    auto & groups = mixture.groups();
+    groups.resize(group_count);
+    for (auto & group : groups) {
+        group.init(shared, rng);
+    }
+    const auto seed = rng();
+    parallel_for(0, group_count, 16,
+        [&shared, &groups, &offsets, &values, seed](size_t groupid) {
+            rng_t group_rng = rng_stream(seed, groupid);
+            detail::dataset_add_values(
+                shared,
+                groups[groupid],
+                values.get() + offsets[groupid],
+                values.get() + offsets[groupid + 1],
+                group_rng,
+                std::is_integral<Value>());
+        });
+    mixture.init(shared, rng);
+}
+
+}   // namespace distributions
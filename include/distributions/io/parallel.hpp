@@ -0,0 +1,130 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <distributions/common.hpp>
+#include <distributions/random.hpp>
+#include <distributions/parallel.hpp>
+#include <distributions/io/stream.hpp>
+
+namespace distributions {
+
+// --------------------------------------------------------------------------
+// Parallel Mixture I/O
+//
+// These load and dump mixture groups as protobuf stream records, one
+// record per group, parsing and serializing on the thread pool.  Records
+// move through the stream serially in batches, and each group has a
+// preallocated slot, so results do not depend on the thread count.
+//
+// To load a many-feature model, run one parallel_load_mixture per feature
+// via parallel_tasks, each with its own rng; the per-feature calls then
+// run serially within a task, one feature per core.
+
+enum {
+    parallel_io_batch_size = 1 << 12,
+    parallel_io_min_chunk_size = 1 << 6
+};
+
+template<class Message, class Group>
+inline void parallel_load_groups(
+        ProtobufStreamReader & stream,
+        std::vector<Group> & groups) {
+    groups.clear();
+    std::vector<std::string> records(parallel_io_batch_size);
+    size_t count;
+    do {
+        count = 0;
+        while (count < records.size() and
+               stream.try_read_stream(records[count])) {
+            ++count;
+        }
+        const size_t offset = groups.size();
+        groups.resize(offset + count);
+        parallel_for_chunks(0, count, parallel_io_min_chunk_size,
+            [&records, &groups, offset](size_t begin, size_t end) {
+                Message message;
+                for (size_t i = begin; i < end; ++i) {
+                    DIST_ASSERT(
+                        message.ParseFromString(records[i]),
+                        "failed to parse group " << (offset + i));
+                    groups[offset + i].protobuf_load(message);
+                }
+            });
+    } while (count == records.size());
+}
+
+template<class Message, class Group>
+inline void parallel_dump_groups(
+        const std::vector<Group> & groups,
+        ProtobufStreamWriter & stream) {
+    std::vector<std::string> records(parallel_io_batch_size);
+    for (size_t offset = 0; offset < groups.size(); offset += records.size()) {
+        const size_t count = std::min(records.size(), groups.size() - offset);
+        parallel_for_chunks(0, count, parallel_io_min_chunk_size,
+            [&records, &groups, offset](size_t begin, size_t end) {
+                Message message;
+                for (size_t i = begin; i < end; ++i) {
+                    groups[offset + i].protobuf_dump(message);
+                    DIST_ASSERT(
+                        message.SerializeToString(& records[i]),
+                        "failed to serialize group " << (offset + i));
+                }
+            });
+        for (size_t i = 0; i < count; ++i) {
+            stream.write_stream(records[i]);
+        }
+    }
+}
+
+// Loads groups, then builds value scorer caches, which models with large
+// caches also build in parallel over ranges of groups.
+template<class Message, class Mixture>
+inline void parallel_load_mixture(
+        const typename Mixture::Shared & shared,
+        const std::string & filename,
+        Mixture & mixture,
+        rng_t & rng) {
+    ProtobufStreamReader stream(filename);
+    parallel_load_groups<Message>(stream, mixture.groups());
+    mixture.init(shared, rng);
+}
+
+template<class Message, class Mixture>
+inline void parallel_dump_mixture(
+        const Mixture & mixture,
+        const std::string & filename) {
+    ProtobufStreamWriter stream(filename);
+    parallel_dump_groups<Message>(mixture.groups(), stream);
+    stream.close();
+}
+
+}   // namespace distributions
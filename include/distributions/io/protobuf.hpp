@@ -32,6 +32,11 @@
 #include <distributions/assert_close.hpp>
 #include <iostream>
 
+#if GOOGLE_PROTOBUF_VERSION >= 3000000
+#  include <google/protobuf/arena.h>
+#  include <google/protobuf/util/message_differencer.h>
+#endif  // GOOGLE_PROTOBUF_VERSION >= 3000000
+
 // make cpplint happy
 #include <utility>
 #include <vector>
@@ -81,11 +86,22 @@ inline std::ostream & operator<<(
 inline bool operator==(
         const Message & x,
         const Message & y) {
-    std::string x_string;
-    std::string y_string;
-    x.SerializeToString(&x_string);
-    y.SerializeToString(&y_string);
-    return x_string == y_string;
+    if (x.GetDescriptor() != y.GetDescriptor()) {
+        return false;
+    }
+#if GOOGLE_PROTOBUF_VERSION >= 3000000
+    return util::MessageDifferencer::Equals(x, y);
+#else  // GOOGLE_PROTOBUF_VERSION >= 3000000
+    const int size = x.ByteSize();
+    if (size != y.ByteSize()) {
+        return false;
+    }
+    std::vector<uint8> buffer(2 * size);
+    x.SerializeWithCachedSizesToArray(buffer.data());
+    y.SerializeWithCachedSizesToArray(buffer.data() + size);
+    return std::equal(buffer.begin(), buffer.begin() + size,
+                      buffer.begin() + size);
+#endif  // GOOGLE_PROTOBUF_VERSION >= 3000000
 }
 
 template<class T>
@@ -144,6 +160,48 @@ DECLARE_MESSAGE(NormalInverseChiSq, , , )
 
 namespace protobuf { using namespace ::protobuf::distributions; }  // NOLINT(*)
 
+// Dumps the groups of a mixture to a repeated message field in one pass.
+template<class Mixture, class Messages>
+inline void protobuf_dump_groups(
+        const Mixture & mixture,
+        Messages & messages) {
+    const auto & groups = mixture.groups();
+    messages.Clear();
+    messages.Reserve(groups.size());
+    for (const auto & group : groups) {
+        group.protobuf_dump(* messages.Add());
+    }
+}
+
+// Loads groups from a repeated message field; call mixture.init() after.
+template<class Messages, class Mixture>
+inline void protobuf_load_groups(
+        const Messages & messages,
+        Mixture & mixture) {
+    auto & groups = mixture.groups();
+    groups.resize(messages.size());
+    for (size_t i = 0, size = groups.size(); i < size; ++i) {
+        groups[i].protobuf_load(messages.Get(i));
+    }
+}
+
+#if GOOGLE_PROTOBUF_VERSION >= 3000000
+
+// Dumps the groups of a mixture into a single arena, so that large
+// mixtures cost a few big allocations rather than several per group.
+// The result is owned by the arena.
+template<class Message, class Mixture>
+inline google::protobuf::RepeatedPtrField<Message> * protobuf_dump_groups(
+        google::protobuf::Arena & arena,
+        const Mixture & mixture) {
+    typedef google::protobuf::RepeatedPtrField<Message> Messages;
+    Messages * messages = google::protobuf::Arena::Create<Messages>(&arena);
+    protobuf_dump_groups(mixture, * messages);
+    return messages;
+}
+
+#endif  // GOOGLE_PROTOBUF_VERSION >= 3000000
+
 // protobuf specializations here
 
 template<>
@@ -0,0 +1,93 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstring>
+#include <type_traits>
+#include <distributions/common.hpp>
+
+// Bulk access to protobuf RepeatedFields of numbers.
+//
+// These are duck-typed on the field so that model headers can use them
+// without depending on protobuf: any Field with Get, Reserve, Resize,
+// AddAlreadyReserved, data and mutable_data will do.
+
+namespace distributions {
+
+template<class Field>
+struct RepeatedFieldElement {
+    typedef typename std::decay<
+        decltype(std::declval<const Field &>().Get(0))>::type t;
+};
+
+// Resizes a field and returns a pointer to its contiguous storage.
+template<class Field>
+inline typename RepeatedFieldElement<Field>::t * repeated_field_resize(
+        Field & field,
+        size_t size) {
+    typedef typename RepeatedFieldElement<Field>::t Element;
+    field.Clear();
+    field.Resize(size, Element());
+    return field.mutable_data();
+}
+
+template<class Field, class T>
+inline void repeated_field_assign(
+        Field & field,
+        const T * data,
+        size_t size) {
+    typedef typename RepeatedFieldElement<Field>::t Element;
+    if (std::is_same<Element, T>::value) {
+        memcpy(repeated_field_resize(field, size), data, size * sizeof(T));
+    } else {
+        field.Clear();
+        field.Reserve(size);
+        for (size_t i = 0; i < size; ++i) {
+            field.AddAlreadyReserved(static_cast<Element>(data[i]));
+        }
+    }
+}
+
+// Copies a field into data, which must have room for field.size() elements.
+template<class Field, class T>
+inline void repeated_field_copy(
+        const Field & field,
+        T * data) {
+    typedef typename RepeatedFieldElement<Field>::t Element;
+    const size_t size = field.size();
+    if (std::is_same<Element, T>::value) {
+        memcpy(data, field.data(), size * sizeof(T));
+    } else {
+        const Element * source = field.data();
+        for (size_t i = 0; i < size; ++i) {
+            data[i] = static_cast<T>(source[i]);
+        }
+    }
+}
+
+}   // namespace distributions
@@ -0,0 +1,188 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <distributions/common.hpp>
+
+namespace distributions {
+
+// --------------------------------------------------------------------------
+// Flat Binary Snapshots
+//
+// A snapshot file is a header, a table of named sections, then the section
+// payloads, each aligned to section_alignment bytes:
+//
+//   SnapshotHeader | SnapshotSection[section_count] | pad | data | pad | ...
+//
+// Sections hold flat arrays of trivially copyable types in native byte
+// order, so a reader can memory-map the file and use them in place.
+// Mixtures dump and load themselves via snapshot_dump/snapshot_load.
+
+enum { snapshot_version = 1, section_alignment = 64 };
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t section_count;
+};
+
+struct SnapshotSection {
+    char name[40];
+    uint64_t offset;
+    uint64_t size;  // in elements
+    uint64_t element_size;
+};
+
+template<class T>
+struct SnapshotArray {
+    const T * data;
+    size_t size;
+
+    const T * begin() const { return data; }
+    const T * end() const { return data + size; }
+    const T & operator[] (size_t i) const { return data[i]; }
+};
+
+class SnapshotWriter {
+ public:
+    // the array must stay alive until write() is called
+    template<class T>
+    void add_array(const std::string & name, const T * data, size_t size) {
+        static_assert(
+            std::is_trivially_copyable<T>::value,
+            "snapshot sections must be trivially copyable");
+        _add(name, data, size, sizeof(T));
+    }
+
+    // like add_array, but the writer keeps the data alive
+    template<class T>
+    void add_vector(const std::string & name, std::vector<T> && data) {
+        auto owned = std::make_shared<std::vector<T>>(std::move(data));
+        add_array(name, owned->data(), owned->size());
+        owned_.push_back(owned);
+    }
+
+    // returns the number of bytes written
+    size_t write(const std::string & filename) const;
+
+ private:
+    struct Pending {
+        std::string name;
+        const void * data;
+        size_t size;
+        size_t element_size;
+    };
+
+    void _add(
+            const std::string & name,
+            const void * data,
+            size_t size,
+            size_t element_size);
+
+    std::vector<Pending> sections_;
+    std::vector<std::shared_ptr<const void>> owned_;
+};
+
+// Maps a snapshot read-only for the lifetime of the reader.
+class SnapshotReader {
+ public:
+    explicit SnapshotReader(const std::string & filename);
+    ~SnapshotReader();
+
+    SnapshotReader(const SnapshotReader &) = delete;
+    void operator=(const SnapshotReader &) = delete;
+
+    bool has(const std::string & name) const {
+        return _find(name) != nullptr;
+    }
+
+    template<class T>
+    SnapshotArray<T> array(const std::string & name) const {
+        const SnapshotSection * section = _find(name);
+        DIST_ASSERT(section, "missing snapshot section: " << name);
+        DIST_ASSERT_EQ(section->element_size, sizeof(T));
+        SnapshotArray<T> result;
+        result.data = reinterpret_cast<const T *>(data_ + section->offset);
+        result.size = section->size;
+        return result;
+    }
+
+ private:
+    const SnapshotSection * _find(const std::string & name) const;
+
+    const char * data_;
+    size_t size_;
+    const SnapshotSection * sections_;
+    size_t section_count_;
+};
+
+// --------------------------------------------------------------------------
+// Snapshot Logs
+//
+// A checkpoint log is a base snapshot followed by deltas, each of which
+// holds only what changed since the previous file; see
+// MixtureSlave::snapshot_dump_delta.  Files are named path, path.1,
+// path.2, ... and are written under a temporary name then renamed, so an
+// interrupted checkpoint leaves a replayable log.  Once the deltas have
+// grown too large relative to the base, the caller compacts the log by
+// writing a fresh base, which deletes all deltas.
+
+class SnapshotLog {
+ public:
+    // opens an existing log at path, if any
+    explicit SnapshotLog(const std::string & path);
+
+    bool empty() const { return not base_size_; }
+    size_t delta_count() const { return delta_count_; }
+
+    // filename(0) is the base, filename(i) is the i-th delta
+    std::string filename(size_t index) const;
+
+    void write_base(const SnapshotWriter & writer);
+    void write_delta(const SnapshotWriter & writer);
+
+    // whether total delta size exceeds ratio times the base size
+    bool should_compact(float ratio = 0.5f) const {
+        return empty() or delta_size_ > ratio * base_size_;
+    }
+
+ private:
+    size_t _write(const SnapshotWriter & writer, size_t index) const;
+
+    const std::string path_;
+    size_t delta_count_;
+    size_t base_size_;
+    size_t delta_size_;
+};
+
+}   // namespace distributions
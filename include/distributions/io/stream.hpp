@@ -0,0 +1,128 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <distributions/common.hpp>
+
+namespace distributions {
+
+// --------------------------------------------------------------------------
+// Protobuf Streams
+//
+// These read and write the format of distributions/io/stream.py, where each
+// record is a little-endian uint32 byte count followed by a serialized
+// message.  As in open_compressed, files ending in .gz or .bz2 are
+// compressed; this needs a build with zlib or bzip2, respectively.
+// Messages are any type with ParseFromString and SerializeToString.
+
+class StreamSource;
+class StreamSink;
+class StreamBlockQueue;
+
+class ProtobufStreamReader {
+ public:
+    // If background is true, a worker thread reads and decompresses
+    // large blocks ahead of parsing.
+    explicit ProtobufStreamReader(
+            const std::string & filename,
+            bool background = true);
+    ~ProtobufStreamReader();
+
+    bool try_read_stream(std::string & record);
+
+    template<class Message>
+    bool try_read_message(Message & message) {
+        if (try_read_stream(record_)) {
+            DIST_ASSERT(
+                message.ParseFromString(record_),
+                "failed to parse message");
+            return true;
+        } else {
+            return false;
+        }
+    }
+
+    // Parses up to batch.size() records into batch, reusing its messages,
+    // and returns the number read, which is zero once the stream ends.
+    template<class Message>
+    size_t try_read_batch(std::vector<Message> & batch) {
+        size_t count = 0;
+        while (count < batch.size() and try_read_message(batch[count])) {
+            ++count;
+        }
+        return count;
+    }
+
+ private:
+    // returns the number of bytes read, short only at end of file
+    size_t _read(char * data, size_t size);
+
+    std::unique_ptr<StreamBlockQueue> blocks_;
+    std::vector<char> block_;
+    size_t pos_;
+    std::string record_;
+};
+
+class ProtobufStreamWriter {
+ public:
+    explicit ProtobufStreamWriter(const std::string & filename);
+    ~ProtobufStreamWriter();
+
+    void write_stream(const char * data, size_t size);
+
+    void write_stream(const std::string & record) {
+        write_stream(record.data(), record.size());
+    }
+
+    template<class Message>
+    void write_message(const Message & message) {
+        DIST_ASSERT(
+            message.SerializeToString(& record_),
+            "failed to serialize message");
+        write_stream(record_);
+    }
+
+    // flush() and close() assert on write errors.  The destructor closes
+    // the stream if needed, but can only log errors, so callers that care
+    // whether their data was written should close() explicitly.
+    void flush();
+    void close();
+
+ private:
+    bool _try_flush();
+
+    const std::string filename_;
+    std::unique_ptr<StreamSink> sink_;
+    std::vector<char> buffer_;
+    std::string record_;
+};
+
+}   // namespace distributions
@@ -0,0 +1,97 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <distributions/common.hpp>
+
+namespace distributions {
+
+// --------------------------------------------------------------------------
+// Varint Coding
+//
+// Unsigned varints are base-128 little-endian as in protobuf, and signed
+// values are zigzag-coded so that small magnitudes stay short.
+
+inline void varint_write(std::string & out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+inline uint64_t varint_read(const char * & pos, const char * end) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        DIST_ASSERT(pos != end, "truncated varint");
+        const uint8_t byte = * pos++;
+        value |= uint64_t(byte & 0x7F) << shift;
+        if (not (byte & 0x80)) {
+            return value;
+        }
+    }
+    DIST_ERROR("malformed varint");
+}
+
+inline uint64_t zigzag_encode(int64_t value) {
+    return (uint64_t(value) << 1) ^ uint64_t(value >> 63);
+}
+
+inline int64_t zigzag_decode(uint64_t value) {
+    return int64_t(value >> 1) ^ -int64_t(value & 1);
+}
+
+// Writes the top byte_count bytes of a float, rounding to nearest,
+// so 4 is exact and 2 is bfloat16.
+inline void float_write(std::string & out, float value, int byte_count) {
+    DIST_ASSERT1(2 <= byte_count and byte_count <= 4, "bad byte count");
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    if (const int drop = 8 * (4 - byte_count)) {
+        bits = (bits + (uint32_t(1) << (drop - 1))) >> drop;
+    }
+    for (int i = 0; i < byte_count; ++i) {
+        out.push_back(static_cast<char>(bits >> (8 * i)));
+    }
+}
+
+inline float float_read(const char * & pos, const char * end, int byte_count) {
+    DIST_ASSERT(end - pos >= byte_count, "truncated float");
+    uint32_t bits = 0;
+    for (int i = 0; i < byte_count; ++i) {
+        bits |= uint32_t(uint8_t(* pos++)) << (8 * i);
+    }
+    bits <<= 8 * (4 - byte_count);
+    float value;
+    memcpy(&value, &bits, 4);
+    return value;
+}
+
+}   // namespace distributions
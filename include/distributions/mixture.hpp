@@ -27,17 +27,89 @@
 
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <vector>
-#include <unordered_set>
 #include <unordered_map>
 #include <type_traits>
 #include <distributions/common.hpp>
 #include <distributions/vector.hpp>
+#include <distributions/vector_math.hpp>
+#include <distributions/sparse.hpp>
 #include <distributions/trivial_hash.hpp>
 #include <distributions/random_fwd.hpp>
 
 namespace distributions {
 
+// --------------------------------------------------------------------------
+// Dense Id Set
+//
+// This is a set of small nonnegative ids with O(1) insert, erase and lookup,
+// and cache-friendly iteration over a compact, unordered list of members.
+// Memory is linear in the largest id ever inserted.
+
+class DenseIdSet {
+ public:
+    typedef const size_t * const_iterator;
+    typedef const_iterator iterator;
+
+    size_t size() const { return ids_.size(); }
+    bool empty() const { return ids_.empty(); }
+    const_iterator begin() const { return ids_.data(); }
+    const_iterator end() const { return ids_.data() + ids_.size(); }
+
+    bool contains(size_t id) const {
+        return id < positions_.size() and positions_[id];
+    }
+
+    void clear() {
+        for (size_t id : ids_) {
+            positions_[id] = 0;
+        }
+        ids_.clear();
+    }
+
+    void insert(size_t id) {
+        if (DIST_UNLIKELY(id >= positions_.size())) {
+            positions_.resize(std::max(id + 1, 2 * positions_.size()), 0);
+        }
+        if (not positions_[id]) {
+            ids_.push_back(id);
+            positions_[id] = ids_.size();
+        }
+    }
+
+    void erase(size_t id) {
+        if (contains(id)) {
+            const size_t pos = positions_[id] - 1;
+            const size_t last = ids_.back();
+            ids_[pos] = last;
+            positions_[last] = pos + 1;
+            ids_.pop_back();
+            positions_[id] = 0;
+        }
+    }
+
+    // mirrors Packed_::packed_remove(id) on a set of packed ids,
+    // where last is the id of the element that was moved to id
+    void packed_remove(size_t id, size_t last) {
+        if (not empty()) {
+            const bool last_is_present = contains(last);
+            erase(last);
+            erase(id);
+            if (last_is_present and id != last) {
+                insert(id);
+            }
+        }
+    }
+
+ private:
+    std::vector<size_t> ids_;
+    std::vector<size_t> positions_;  // 1 + position in ids_, or 0 if absent
+};
+
+
 // --------------------------------------------------------------------------
 // Mixture Driver
 //
@@ -48,7 +120,7 @@ namespace distributions {
 template<class Model_, class count_t>
 struct MixtureDriver {
     typedef Model_ Model;
-    typedef std::unordered_set<size_t, TrivialHash<size_t>> IdSet;
+    typedef DenseIdSet IdSet;
 
     std::vector<count_t> & counts() { return counts_; }
     const std::vector<count_t> & counts() const { return counts_; }
@@ -131,7 +203,7 @@ struct MixtureDriver {
         const count_t group_count = counts_.size();
         const count_t empty_group_count = empty_groupids_.size();
         const count_t nonempty_group_count = group_count - empty_group_count;
-        for (size_t i = 0; i < group_count; ++i) {
+        for (count_t i = 0; i < group_count; ++i) {
             scores[i] = model.score_add_value(
                 counts_[i],
                 nonempty_group_count,
@@ -154,8 +226,7 @@ struct MixtureDriver {
         if (DIST_DEBUG_LEVEL >= 2) {
             for (size_t i = 0; i < counts_.size(); ++i) {
                 bool count_is_zero = (counts_[i] == 0);
-                bool is_empty =
-                    (empty_groupids_.find(i) != empty_groupids_.end());
+                bool is_empty = empty_groupids_.contains(i);
                 DIST_ASSERT_EQ(count_is_zero, is_empty);
             }
         }
@@ -172,6 +243,8 @@ struct MixtureSlaveGroups {
     typedef typename Model::Group Group;
     typedef typename Model::Value Value;
 
+    MixtureSlaveGroups() : track_changes_(false) {}
+
     std::vector<Group> & groups() { return groups_; }
     Group & groups(size_t groupid) {
         DIST_ASSERT1(groupid < groups_.size(), "bad groupid: " << groupid);
@@ -189,6 +262,9 @@ struct MixtureSlaveGroups {
             const Shared & shared,
             rng_t & rng) {
         groups_.packed_add().init(shared, rng);
+        if (track_changes_) {
+            changed_.insert(groups_.size() - 1);
+        }
     }
 
     // remove_group is called whenever driver.remove_value returns true
@@ -196,6 +272,7 @@ struct MixtureSlaveGroups {
             const Shared &,
             size_t groupid) {
         groups_.packed_remove(groupid);
+        changed_.packed_remove(groupid, groups_.size());
     }
 
     void add_value(
@@ -204,6 +281,9 @@ struct MixtureSlaveGroups {
             const Value & value,
             rng_t & rng) {
         groups(groupid).add_value(shared, value, rng);
+        if (track_changes_) {
+            changed_.insert(groupid);
+        }
     }
 
     void remove_value(
@@ -212,7 +292,21 @@ struct MixtureSlaveGroups {
             const Value & value,
             rng_t & rng) {
         groups(groupid).remove_value(shared, value, rng);
+        if (track_changes_) {
+            changed_.insert(groupid);
+        }
+    }
+
+    // While tracking changes, this records the packed ids of groups added
+    // or modified via the methods above since the last clear_changed().
+    // Direct writes through groups() are not tracked.
+    bool track_changes() const { return track_changes_; }
+    void set_track_changes(bool track_changes) {
+        track_changes_ = track_changes;
+        changed_.clear();
     }
+    const DenseIdSet & changed() const { return changed_; }
+    void clear_changed() { changed_.clear(); }
 
     void validate(const Shared & shared) const {
         for (auto const & group : groups_) {
@@ -222,6 +316,8 @@ struct MixtureSlaveGroups {
 
  private:
     Packed_<Group> groups_;
+    bool track_changes_;
+    DenseIdSet changed_;
 };
 
 template<class Model_, class Derived>
@@ -274,6 +370,14 @@ struct MixtureSlaveValueScorerMixin {
     typedef typename Model::Shared Shared;
     typedef typename Model::Group Group;
 
+    // Whether add_value/remove_value may be replaced by a later
+    // update_group or update_all, as in MixtureSlave's deferred mode.
+    enum { supports_deferred_updates = true };
+
+    // Whether FrozenMixture should tabulate scores of every value listed by
+    // frozen_domain(shared, values), rather than copy this scorer.
+    enum { tabulate_when_frozen = false };
+
     void resize(const Shared &, size_t) {}
     void add_group(const Shared &, rng_t &) {}
     void remove_group(const Shared &, size_t) {}
@@ -294,6 +398,33 @@ struct MixtureSlaveValueScorerMixin {
             const Value &,
             rng_t &) {}
 
+    template<class Writer>
+    void snapshot_dump(const Shared &, Writer &, const std::string &) const {}
+
+    // returns false if caches must instead be rebuilt by update_all, e.g.
+    // because they were dumped with a different Shared
+    template<class Reader>
+    bool snapshot_load(
+            const Shared &,
+            const Reader &,
+            const std::string &,
+            size_t) {
+        return false;
+    }
+
+    // scores value against groups[groupid] as if value were removed from it;
+    // models whose groups are expensive to copy should override this
+    float score_value_group_removed(
+            const Shared & shared,
+            const std::vector<Group> & groups,
+            size_t groupid,
+            const Value & value,
+            rng_t & rng) const {
+        Group group = groups[groupid];
+        group.remove_value(shared, value, rng);
+        return group.score_value(shared, value, rng);
+    }
+
     void validate(const Shared &, const std::vector<Group> &) const {}
 };
 
@@ -337,6 +468,196 @@ struct SmallMixtureSlaveValueScorer : MixtureSlaveValueScorerMixin<Model> {
     }
 };
 
+// FrozenValueScorer holds the read-only value scores of a FrozenMixture.
+// Models with small finite value domains are compiled into one dense table
+// holding a row of per-group scores for each value, with the per-group
+// normalizing constants already subtracted; rows start on cache lines.
+// Other models keep a copy of their scorer, whose caches are already
+// per-group constants.
+
+template<
+    class Model,
+    class ValueScorer,
+    bool tabulate = ValueScorer::tabulate_when_frozen>
+class FrozenValueScorer {
+ public:
+    typedef typename Model::Value Value;
+    typedef typename Model::Shared Shared;
+    typedef typename Model::Group Group;
+
+    FrozenValueScorer(
+            const Shared &,
+            const std::vector<Group> &,
+            const ValueScorer & value_scorer,
+            rng_t &) :
+        value_scorer_(value_scorer) {}
+
+    float score_value_group(
+            const Shared & shared,
+            const std::vector<Group> & groups,
+            size_t groupid,
+            const Value & value) const {
+        rng_t unused;
+        return value_scorer_.score_value_group(
+            shared,
+            groups,
+            groupid,
+            value,
+            unused);
+    }
+
+    void score_value(
+            const Shared & shared,
+            const std::vector<Group> & groups,
+            const Value & value,
+            AlignedFloats scores_accum) const {
+        rng_t unused;
+        value_scorer_.score_value(
+            shared,
+            groups,
+            value,
+            scores_accum,
+            unused);
+    }
+
+ private:
+    const ValueScorer value_scorer_;
+};
+
+template<class Model, class ValueScorer>
+class FrozenValueScorer<Model, ValueScorer, true> {
+ public:
+    typedef typename Model::Value Value;
+    typedef typename Model::Shared Shared;
+    typedef typename Model::Group Group;
+
+    FrozenValueScorer(
+            const Shared & shared,
+            const std::vector<Group> & groups,
+            const ValueScorer & value_scorer,
+            rng_t & rng) :
+        stride_((groups.size() + floats_per_line - 1) /
+                floats_per_line * floats_per_line),
+        direct_count_(0) {
+        std::vector<Value> values;
+        value_scorer.frozen_domain(shared, values);
+        std::sort(values.begin(), values.end());
+
+        // values 0, 1, ... index rows directly; the rest are hashed
+        while (direct_count_ < values.size() and
+               static_cast<size_t>(values[direct_count_]) == direct_count_) {
+            ++direct_count_;
+        }
+        for (size_t row = direct_count_; row < values.size(); ++row) {
+            rows_.add(values[row], row);
+        }
+
+        table_.resize(values.size() * stride_, 0.f);
+        for (size_t row = 0; row < values.size(); ++row) {
+            AlignedFloats scores(table_.data() + row * stride_, groups.size());
+            value_scorer.score_value(shared, groups, values[row], scores, rng);
+        }
+    }
+
+    float score_value_group(
+            const Shared &,
+            const std::vector<Group> &,
+            size_t groupid,
+            const Value & value) const {
+        return _row(value)[groupid];
+    }
+
+    void score_value(
+            const Shared &,
+            const std::vector<Group> &,
+            const Value & value,
+            AlignedFloats scores_accum) const {
+        vector_add(scores_accum.size(), scores_accum.data(), _row(value));
+    }
+
+ private:
+    const float * _row(const Value & value) const {
+        const size_t direct = static_cast<size_t>(value);
+        const size_t row = DIST_LIKELY(direct < direct_count_)
+                         ? direct
+                         : rows_.get(value);
+        return table_.data() + row * stride_;
+    }
+
+    enum { line_size = 64 };
+    enum { floats_per_line = line_size / sizeof(float) };
+
+    const size_t stride_;
+    size_t direct_count_;
+    Sparse_<Value, uint32_t> rows_;
+    std::vector<float, aligned_allocator<float, line_size>> table_;
+};
+
+// A read-only snapshot of a MixtureSlave, as returned by freeze(), for
+// serving predictions.  Scoring is const, needs no rng and uses only
+// thread-local scratch, so many threads may score one FrozenMixture at once.
+
+template<class Model, class ValueScorer>
+class FrozenMixture {
+ public:
+    typedef typename Model::Value Value;
+    typedef typename Model::Shared Shared;
+    typedef typename Model::Group Group;
+
+    FrozenMixture(
+            const Shared & shared,
+            std::shared_ptr<const MixtureSlaveGroups<Shared>> groups,
+            const ValueScorer & value_scorer,
+            rng_t & rng) :
+        shared_(shared),
+        groups_(groups),
+        value_scorer_(shared_, groups_->groups(), value_scorer, rng) {}
+
+    const Shared & shared() const { return shared_; }
+    const std::vector<Group> & groups() const { return groups_->groups(); }
+    size_t size() const { return groups_->groups().size(); }
+
+    float score_value_group(size_t groupid, const Value & value) const {
+        if (DIST_DEBUG_LEVEL >= 2) {
+            DIST_ASSERT_LT(groupid, size());
+        }
+        return value_scorer_.score_value_group(
+            shared_,
+            groups(),
+            groupid,
+            value);
+    }
+
+    void score_value(const Value & value, AlignedFloats scores_accum) const {
+        if (DIST_DEBUG_LEVEL >= 2) {
+            DIST_ASSERT_EQ(scores_accum.size(), size());
+        }
+        value_scorer_.score_value(shared_, groups(), value, scores_accum);
+    }
+
+ private:
+    const Shared shared_;
+    const std::shared_ptr<const MixtureSlaveGroups<Shared>> groups_;
+    const FrozenValueScorer<Model, ValueScorer> value_scorer_;
+};
+
+// Accumulates the scores of one row into scores_accum, given each observed
+// feature's FrozenMixture followed by its value, as in
+//   score_row(scores_accum, frozen_bb, true, frozen_dd, 3);
+// Unobserved features are left out.
+
+inline void score_row(AlignedFloats) {}
+
+template<class Frozen, class... Features>
+inline void score_row(
+        AlignedFloats scores_accum,
+        const Frozen & frozen,
+        const typename Frozen::Value & value,
+        const Features & ... features) {
+    frozen.score_value(value, scores_accum);
+    score_row(scores_accum, features...);
+}
+
 template<
     class Model,  // NOLINT(*)
     class DataScorer = SmallMixtureSlaveDataScorer<Model>,
@@ -346,32 +667,101 @@ struct MixtureSlave {
     typedef typename Model::Shared Shared;
     typedef typename Model::Group Group;
 
-    std::vector<Group> & groups() { return groups_.groups(); }
-    Group & groups(size_t i) { return groups_.groups(i); }
-    const std::vector<Group> & groups() const { return groups_.groups(); }
-    const Group & groups(size_t i) const { return groups_.groups(i); }
+    MixtureSlave() :
+        groups_(std::make_shared<MixtureSlaveGroups<Shared>>()),
+        value_scorer_(std::make_shared<ValueScorer>()),
+        deferred_(false),
+        read_only_(false) {}
+
+    // Copies share groups and scorer caches until either side first writes
+    // to them.  Sharing is per component, so the first write to a copy
+    // copies all its groups or its whole value scorer; copies may then be
+    // written from different threads.
+    //
+    // A fork is a copy that may only score, say to evaluate tempered or
+    // proposed states against a shared chain, and costs O(1) for as long
+    // as it lives.  Writing to a fork fails an assertion.  Chains that
+    // mutate need their own copies.  fork() must not race with mutation of
+    // its source, but the source may mutate while forks score.
+    MixtureSlave fork() const {
+        DIST_ASSERT(dirty_.empty(), "flush before fork");
+        MixtureSlave result(*this);
+        result.read_only_ = true;
+        return result;
+    }
+
+    bool read_only() const { return read_only_; }
+
+    // Flushes deferred updates, then compiles the scorer caches into a
+    // FrozenValueScorer; groups stay shared copy-on-write.  Like fork(), freeze must
+    // not race with mutation of this mixture.
+    FrozenMixture<Model, ValueScorer> freeze(
+            const Shared & shared,
+            rng_t & rng) const {
+        flush(shared, rng);
+        return FrozenMixture<Model, ValueScorer>(
+            shared,
+            groups_,
+            * value_scorer_,
+            rng);
+    }
+
+    std::vector<Group> & groups() { return _writable_groups().groups(); }
+    Group & groups(size_t i) { return _writable_groups().groups(i); }
+    const std::vector<Group> & groups() const { return groups_->groups(); }
+    const Group & groups(size_t i) const { return groups_->groups(i); }
 
     void init(
             const Shared & shared,
             rng_t & rng) {
-        value_scorer_.resize(shared, groups().size());
-        value_scorer_.update_all(shared, groups(), rng);
+        dirty_.clear();
+        const auto & groups = groups_->groups();
+        _writable_value_scorer().resize(shared, groups.size());
+        _writable_value_scorer().update_all(shared, groups, rng);
+    }
+
+    // In deferred mode, add_value and remove_value only mark groups dirty,
+    // and dirty groups are refreshed in one batch by the next scoring call
+    // or flush().  This suits bulk loading, but since scoring then writes
+    // to caches, a deferred mixture must not be scored concurrently.
+    // Value scorers without supports_deferred_updates stay eager.
+    bool deferred() const { return deferred_; }
+
+    void set_deferred(
+            const Shared & shared,
+            bool deferred,
+            rng_t & rng) {
+        flush(shared, rng);
+        deferred_ = deferred and ValueScorer::supports_deferred_updates;
+    }
+
+    void flush(
+            const Shared & shared,
+            rng_t & rng) const {
+        if (DIST_UNLIKELY(not dirty_.empty())) {
+            _flush(shared, rng);
+        }
     }
 
     void add_group(
             const Shared & shared,
             rng_t & rng) {
         const size_t groupid = groups().size();
-        groups_.add_group(shared, rng);
-        value_scorer_.add_group(shared, rng);
-        value_scorer_.update_group(shared, groupid, groups(groupid), rng);
+        _writable_groups().add_group(shared, rng);
+        _writable_value_scorer().add_group(shared, rng);
+        _writable_value_scorer().update_group(
+            shared,
+            groupid,
+            groups(groupid),
+            rng);
     }
 
     void remove_group(
             const Shared & shared,
             size_t groupid) {
-        groups_.remove_group(shared, groupid);
-        value_scorer_.remove_group(shared, groupid);
+        _writable_groups().remove_group(shared, groupid);
+        _writable_value_scorer().remove_group(shared, groupid);
+        dirty_.packed_remove(groupid, groups().size());
     }
 
     void add_value(
@@ -379,8 +769,17 @@ struct MixtureSlave {
             size_t groupid,
             const Value & value,
             rng_t & rng) {
-        groups_.add_value(shared, groupid, value, rng);
-        value_scorer_.add_value(shared, groupid, groups(groupid), value, rng);
+        _writable_groups().add_value(shared, groupid, value, rng);
+        if (deferred_) {
+            dirty_.insert(groupid);
+        } else {
+            _writable_value_scorer().add_value(
+                shared,
+                groupid,
+                groups(groupid),
+                value,
+                rng);
+        }
     }
 
     void remove_value(
@@ -388,13 +787,32 @@ struct MixtureSlave {
             size_t groupid,
             const Value & value,
             rng_t & rng) {
-        groups_.remove_value(shared, groupid, value, rng);
-        value_scorer_.remove_value(
-            shared,
-            groupid,
-            groups(groupid),
-            value,
-            rng);
+        _writable_groups().remove_value(shared, groupid, value, rng);
+        if (deferred_) {
+            dirty_.insert(groupid);
+        } else {
+            _writable_value_scorer().remove_value(
+                shared,
+                groupid,
+                groups(groupid),
+                value,
+                rng);
+        }
+    }
+
+    // A Gibbs step can call remove_and_score_value, sample new_groupid,
+    // then move_value, so that value scorers are updated only if the value
+    // actually moves.  Both groups must already exist.
+    void move_value(
+            const Shared & shared,
+            size_t old_groupid,
+            size_t new_groupid,
+            const Value & value,
+            rng_t & rng) {
+        if (old_groupid != new_groupid) {
+            remove_value(shared, old_groupid, value, rng);
+            add_value(shared, new_groupid, value, rng);
+        }
     }
 
     float score_value_group(
@@ -405,7 +823,8 @@ struct MixtureSlave {
         if (DIST_DEBUG_LEVEL >= 2) {
             DIST_ASSERT_LT(groupid, groups().size());
         }
-        return value_scorer_.score_value_group(
+        flush(shared, rng);
+        return value_scorer_->score_value_group(
             shared,
             groups(),
             groupid,
@@ -421,7 +840,32 @@ struct MixtureSlave {
         if (DIST_DEBUG_LEVEL >= 2) {
             DIST_ASSERT_EQ(scores_accum.size(), groups().size());
         }
-        value_scorer_.score_value(shared, groups(), value, scores_accum, rng);
+        flush(shared, rng);
+        value_scorer_->score_value(shared, groups(), value, scores_accum, rng);
+    }
+
+    // like score_value after remove_value(shared, groupid, value, rng),
+    // but without modifying the mixture
+    void remove_and_score_value(
+            const Shared & shared,
+            size_t groupid,
+            const Value & value,
+            AlignedFloats scores_accum,
+            rng_t & rng) const {
+        if (DIST_DEBUG_LEVEL >= 2) {
+            DIST_ASSERT_EQ(scores_accum.size(), groups().size());
+            DIST_ASSERT_LT(groupid, groups().size());
+        }
+        flush(shared, rng);
+        const float accum = scores_accum[groupid];
+        value_scorer_->score_value(shared, groups(), value, scores_accum, rng);
+        scores_accum[groupid] =
+            accum + value_scorer_->score_value_group_removed(
+                shared,
+                groups(),
+                groupid,
+                value,
+                rng);
     }
 
     float score_data(
@@ -437,16 +881,182 @@ struct MixtureSlave {
         data_scorer_.score_data_grid(shareds, groups(), scores_out, rng);
     }
 
+    // A snapshot holds the groups and any value scorer caches that support
+    // it, so snapshot_load can skip update_all.  Caches are tagged with the
+    // Shared they were dumped with, and are rebuilt if loaded with another.
+    //
+    // Only models with trivially copyable groups can be snapshotted, which
+    // excludes DPD (sparse counts) and NIW (Eigen matrices).  Loading
+    // copies every section out of the reader rather than serving from the
+    // mapping, since the mixture owns its groups and caches and resumes
+    // mutating them; the reader may be closed as soon as load returns.
+    template<class Writer>
+    void snapshot_dump(
+            const Shared & shared,
+            Writer & writer,
+            const std::string & prefix) const {
+        static_assert(
+            std::is_trivially_copyable<Group>::value,
+            "this model's groups do not support snapshots");
+        DIST_ASSERT(dirty_.empty(), "flush before snapshot_dump");
+        writer.add_array(prefix + "groups", groups().data(), groups().size());
+        value_scorer_->snapshot_dump(shared, writer, prefix + "scorer.");
+    }
+
+    template<class Reader>
+    void snapshot_load(
+            const Shared & shared,
+            const Reader & reader,
+            const std::string & prefix,
+            rng_t & rng) {
+        static_assert(
+            std::is_trivially_copyable<Group>::value,
+            "this model's groups do not support snapshots");
+        const auto array = reader.template array<Group>(prefix + "groups");
+        groups().assign(array.begin(), array.end());
+        _writable_groups().clear_changed();
+        dirty_.clear();
+        _writable_value_scorer().resize(shared, groups().size());
+        const bool cached = _writable_value_scorer().snapshot_load(
+            shared,
+            reader,
+            prefix + "scorer.",
+            groups().size());
+        if (not cached) {
+            _writable_value_scorer().update_all(shared, groups(), rng);
+        }
+    }
+
+    // Incremental checkpoints: with change tracking on, a delta holds only
+    // the groups added or modified since the last clear_changes(), keyed by
+    // global id.  A delta is replayed onto the mixture as of the previous
+    // checkpoint, given the id trackers from before and after the delta.
+    // Callers dump the tracker alongside, and must not compact it between
+    // a base snapshot and its deltas.
+    bool track_changes() const { return groups_->track_changes(); }
+    void set_track_changes(bool track_changes) {
+        _writable_groups().set_track_changes(track_changes);
+    }
+    void clear_changes() { _writable_groups().clear_changed(); }
+    size_t changed_count() const { return groups_->changed().size(); }
+
+    template<class Writer, class Ids>
+    void snapshot_dump_delta(
+            Writer & writer,
+            const std::string & prefix,
+            const Ids & ids) const {
+        DIST_ASSERT(track_changes(), "change tracking is off");
+        DIST_ASSERT_EQ(ids.packed_size(), groups().size());
+        std::vector<typename Ids::Id> globals;
+        std::vector<Group> changed;
+        globals.reserve(changed_count());
+        changed.reserve(changed_count());
+        for (size_t groupid : groups_->changed()) {
+            globals.push_back(ids.packed_to_global(groupid));
+            changed.push_back(groups(groupid));
+        }
+        writer.add_vector(prefix + "delta.globals", std::move(globals));
+        writer.add_vector(prefix + "delta.groups", std::move(changed));
+    }
+
+    template<class Reader, class Ids>
+    void snapshot_load_delta(
+            const Shared & shared,
+            const Reader & reader,
+            const std::string & prefix,
+            const Ids & old_ids,
+            const Ids & new_ids,
+            rng_t & rng) {
+        typedef typename Ids::Id Id;
+        DIST_ASSERT_EQ(old_ids.packed_size(), groups().size());
+        const auto globals =
+            reader.template array<Id>(prefix + "delta.globals");
+        const auto changed =
+            reader.template array<Group>(prefix + "delta.groups");
+        DIST_ASSERT_EQ(globals.size, changed.size);
+
+        std::vector<Group> old_groups;
+        old_groups.swap(groups());
+        const size_t group_count = new_ids.packed_size();
+        groups().resize(group_count);
+        std::vector<bool> loaded(group_count, false);
+        for (size_t groupid = 0; groupid < group_count; ++groupid) {
+            const Id global = new_ids.packed_to_global(groupid);
+            if (old_ids.has_global(global)) {
+                groups(groupid) = old_groups[old_ids.global_to_packed(global)];
+                loaded[groupid] = true;
+            }
+        }
+        for (size_t i = 0; i < globals.size; ++i) {
+            const size_t groupid = new_ids.global_to_packed(globals[i]);
+            groups(groupid) = changed[i];
+            loaded[groupid] = true;
+        }
+        for (size_t groupid = 0; groupid < group_count; ++groupid) {
+            DIST_ASSERT(loaded[groupid], "delta is missing group " << groupid);
+        }
+
+        _writable_groups().clear_changed();
+        dirty_.clear();
+        _writable_value_scorer().resize(shared, group_count);
+        _writable_value_scorer().update_all(shared, groups(), rng);
+    }
+
     void validate(const Shared & shared) const {
-        groups_.validate(shared);
-        value_scorer_.validate(shared, groups());
+        groups_->validate(shared);
+        if (dirty_.empty()) {
+            value_scorer_->validate(shared, groups());
+        }
         data_scorer_.validate(shared, groups());
     }
 
  private:
-    MixtureSlaveGroups<Shared> groups_;
-    ValueScorer value_scorer_;
+    void _flush(
+            const Shared & shared,
+            rng_t & rng) const {
+        // past a quarter of the groups, the vectorized update_all wins
+        if (dirty_.size() * 4 >= groups().size()) {
+            _writable_value_scorer().update_all(shared, groups(), rng);
+        } else {
+            for (size_t groupid : dirty_) {
+                _writable_value_scorer().update_group(
+                    shared,
+                    groupid,
+                    groups(groupid),
+                    rng);
+            }
+        }
+        dirty_.clear();
+    }
+
+    // use_count() is a relaxed load, so on seeing sole ownership, fence
+    // before writing, to order the writes after other owners' last reads.
+    template<class T>
+    static T & _unshare(std::shared_ptr<T> & ptr) {
+        if (ptr.use_count() == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } else {
+            ptr = std::make_shared<T>(*ptr);
+        }
+        return *ptr;
+    }
+
+    MixtureSlaveGroups<Shared> & _writable_groups() {
+        DIST_ASSERT(not read_only_, "cannot write to a fork");
+        return _unshare(groups_);
+    }
+
+    ValueScorer & _writable_value_scorer() const {
+        DIST_ASSERT(not read_only_, "cannot write to a fork");
+        return _unshare(value_scorer_);
+    }
+
+    std::shared_ptr<MixtureSlaveGroups<Shared>> groups_;
+    mutable std::shared_ptr<ValueScorer> value_scorer_;
     DataScorer data_scorer_;
+    bool deferred_;
+    bool read_only_;
+    mutable DenseIdSet dirty_;
 };
 
 
@@ -455,15 +1065,19 @@ struct MixtureSlave {
 //
 // This interface tracks a mapping between contiguous "packed" group ids
 // and fixed unique "global" ids.  Packed ids can change when groups are
-// added or removed, but global ids never change.
+// added or removed, but global ids never change, except via compact().
+//
+// Global ids are allocated densely, so both directions are plain array
+// lookups; removed global ids leave tombstones until compact() is called.
 
 struct MixtureIdTracker {
     typedef uint32_t Id;
 
+    enum : Id { tombstone = ~Id(0) };
+
     void init(size_t group_count = 0) {
         packed_to_global_.clear();
         global_to_packed_.clear();
-        global_size_ = 0;
         for (size_t i = 0; i < group_count; ++i) {
             add_group();
         }
@@ -471,25 +1085,25 @@ struct MixtureIdTracker {
 
     void add_group() {
         const Id packed = packed_to_global_.size();
-        const Id global = global_size_++;
+        const Id global = global_to_packed_.size();
+        DIST_ASSERT1(global != tombstone, "too many global ids");
         packed_to_global_.packed_add(global);
-        global_to_packed_.insert(std::make_pair(global, packed));
+        global_to_packed_.push_back(packed);
     }
 
     void remove_group(Id packed) {
         DIST_ASSERT1(packed < packed_size(), "bad packed id: " << packed);
         const Id global = packed_to_global_[packed];
         DIST_ASSERT1(global < global_size(), "bad global id: " << global);
-        global_to_packed_.erase(global);
+        global_to_packed_[global] = tombstone;
         packed_to_global_.packed_remove(packed);
         if (packed != packed_size()) {
             const Id global = packed_to_global_[packed];
             DIST_ASSERT1(global < global_size(), "bad global id: " << global);
-            auto i = global_to_packed_.find(global);
             DIST_ASSERT1(
-                i != global_to_packed_.end(),
+                global_to_packed_[global] != tombstone,
                 "stale global id: " << global);
-            i->second = packed;
+            global_to_packed_[global] = packed;
         }
     }
 
@@ -502,22 +1116,84 @@ struct MixtureIdTracker {
 
     Id global_to_packed(Id global) const {
         DIST_ASSERT1(global < global_size(), "bad global id: " << global);
-        auto i = global_to_packed_.find(global);
-        DIST_ASSERT1(
-            i != global_to_packed_.end(),
-            "stale global id: " << global);
-        Id packed = i->second;
+        Id packed = global_to_packed_[global];
+        DIST_ASSERT1(packed != tombstone, "stale global id: " << global);
         DIST_ASSERT1(packed < packed_size(), "bad packed id: " << packed);
         return packed;
     }
 
+    void packed_to_global(size_t size, const Id * packed, Id * global) const {
+        for (size_t i = 0; i < size; ++i) {
+            global[i] = packed_to_global(packed[i]);
+        }
+    }
+
+    void global_to_packed(size_t size, const Id * global, Id * packed) const {
+        for (size_t i = 0; i < size; ++i) {
+            packed[i] = global_to_packed(global[i]);
+        }
+    }
+
+    bool has_global(Id global) const {
+        return global < global_size()
+            and global_to_packed_[global] != tombstone;
+    }
+
     size_t packed_size() const { return packed_to_global_.size(); }
-    size_t global_size() const { return global_size_; }
+    size_t global_size() const { return global_to_packed_.size(); }
+    size_t tombstone_count() const { return global_size() - packed_size(); }
+
+    // Renumbers live global ids to [0, packed_size()), preserving order,
+    // and calls renumber(old_global, new_global) for each id that changes.
+    // Long-running callers can do this whenever tombstones dominate.
+    template<class Renumber>
+    void compact(Renumber renumber) {
+        Id new_global = 0;
+        for (size_t old_global = 0; old_global < global_size(); ++old_global) {
+            const Id packed = global_to_packed_[old_global];
+            if (packed != tombstone) {
+                if (new_global != old_global) {
+                    global_to_packed_[new_global] = packed;
+                    packed_to_global_[packed] = new_global;
+                    renumber(Id(old_global), new_global);
+                }
+                ++new_global;
+            }
+        }
+        global_to_packed_.resize(new_global);
+    }
+
+    void compact() { compact([](Id, Id) {}); }
+
+    template<class Writer>
+    void snapshot_dump(Writer & writer, const std::string & prefix) const {
+        writer.add_array(
+            prefix + "packed_to_global",
+            packed_to_global_.data(),
+            packed_to_global_.size());
+        writer.add_array(
+            prefix + "global_to_packed",
+            global_to_packed_.data(),
+            global_to_packed_.size());
+    }
+
+    template<class Reader>
+    void snapshot_load(const Reader & reader, const std::string & prefix) {
+        const auto packed_to_global =
+            reader.template array<Id>(prefix + "packed_to_global");
+        const auto global_to_packed =
+            reader.template array<Id>(prefix + "global_to_packed");
+        packed_to_global_.assign(
+            packed_to_global.begin(),
+            packed_to_global.end());
+        global_to_packed_.assign(
+            global_to_packed.begin(),
+            global_to_packed.end());
+    }
 
  private:
     Packed_<Id> packed_to_global_;
-    std::unordered_map<Id, Id, TrivialHash<Id>> global_to_packed_;
-    size_t global_size_;
+    std::vector<Id> global_to_packed_;  // tombstone for removed groups
 };
 
 }   // namespace distributions
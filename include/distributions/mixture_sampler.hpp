@@ -0,0 +1,139 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+#include <distributions/common.hpp>
+#include <distributions/random.hpp>
+#include <distributions/parallel.hpp>
+
+namespace distributions {
+
+// --------------------------------------------------------------------------
+// Mixture Sampler
+//
+// This draws synthetic values from a mixture's posterior predictive in bulk.
+// Each group's Sampler is built once, then sample() fills a column of values
+// for a batch of assignments, as from PitmanYor::sample_posterior_assignments.
+// Every group draws from its own rng stream, in parallel, so the values do
+// not depend on the thread count.
+
+template<class Model>
+class MixtureSampler {
+ public:
+    typedef typename Model::Value Value;
+    typedef typename Model::Shared Shared;
+    typedef typename Model::Group Group;
+    typedef typename Model::Sampler Sampler;
+
+    size_t size() const { return samplers_.size(); }
+
+    void init(
+            const Shared & shared,
+            const std::vector<Group> & groups,
+            rng_t & rng) {
+        const size_t group_count = groups.size();
+        samplers_.clear();
+        samplers_.resize(group_count);
+        const auto seed = rng();
+        parallel_for(0, group_count, 16,
+            [this, &shared, &groups, seed](size_t groupid) {
+                rng_t group_rng = rng_stream(seed, groupid);
+                samplers_[groupid].init(shared, groups[groupid], group_rng);
+            });
+    }
+
+    // adds samplers for new groups, drawn from the prior, up to group_count
+    void resize(
+            const Shared & shared,
+            size_t group_count,
+            rng_t & rng) {
+        const size_t old_count = samplers_.size();
+        if (group_count <= old_count) {
+            return;
+        }
+        samplers_.resize(group_count);
+        const auto seed = rng();
+        parallel_for(old_count, group_count, 16,
+            [this, &shared, seed](size_t groupid) {
+                rng_t group_rng = rng_stream(seed, groupid);
+                Group group;
+                group.init(shared, group_rng);
+                samplers_[groupid].init(shared, group, group_rng);
+            });
+    }
+
+    // sets values[row] for each row of a batch; values must not alias
+    template<class Id>
+    void sample(
+            const Shared & shared,
+            const Id * assignments,
+            size_t row_count,
+            Value * values,
+            rng_t & rng) const {
+        const size_t group_count = samplers_.size();
+
+        // bucket rows by group, as in a counting sort
+        std::vector<size_t> offsets(group_count + 1, 0);
+        for (size_t row = 0; row < row_count; ++row) {
+            const size_t groupid = assignments[row];
+            DIST_ASSERT(groupid < group_count, "bad groupid: " << groupid);
+            ++offsets[groupid + 1];
+        }
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        std::vector<size_t> rows(row_count);
+        {
+            std::vector<size_t> ends(offsets.begin(), offsets.end() - 1);
+            for (size_t row = 0; row < row_count; ++row) {
+                rows[ends[assignments[row]]++] = row;
+            }
+        }
+
+        const auto seed = rng();
+        parallel_for(0, group_count, 16,
+            [this, &shared, &offsets, &rows, values, seed](size_t groupid) {
+                const size_t begin = offsets[groupid];
+                const size_t end = offsets[groupid + 1];
+                if (begin == end) {
+                    return;
+                }
+                rng_t group_rng = rng_stream(seed, groupid);
+                const Sampler & sampler = samplers_[groupid];
+                for (size_t i = begin; i < end; ++i) {
+                    values[rows[i]] = sampler.eval(shared, group_rng);
+                }
+            });
+    }
+
+ private:
+    std::vector<Sampler> samplers_;
+};
+
+}   // namespace distributions
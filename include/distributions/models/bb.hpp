@@ -27,6 +27,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <distributions/common.hpp>
 #include <distributions/special.hpp>
@@ -39,7 +40,7 @@
 namespace distributions {
 struct BetaBernoulli {
 typedef BetaBernoulli Model;
-typedef int count_t;
+typedef ::distributions::count_t count_t;
 typedef bool Value;
 struct Group;
 struct Scorer;
@@ -54,6 +55,16 @@ typedef FastMixture Mixture;
 struct Shared : SharedMixin<Model> {
     float alpha;
     float beta;
+    LgammaOffsetCache lgamma_cache;
+
+    enum { lgamma_alpha, lgamma_beta, lgamma_alpha_beta };
+
+    LgammaOffsetCache::TablePtr lgamma_table(
+            size_t size,
+            size_t lookup_count) const {
+        const float offsets[] = {alpha, beta, alpha + beta};
+        return lgamma_cache.get(offsets, 3, size, lookup_count);
+    }
 
     template<class Message>
     void protobuf_load(const Message & message) {
@@ -109,7 +120,7 @@ struct Group : GroupMixin<Model> {
     void add_repeated_value(
             const Shared &,
             const Value & value,
-            const int & count,
+            const count_t & count,
             rng_t &) {
         (value ? heads : tails) += count;
     }
@@ -210,25 +221,35 @@ struct MixtureDataScorer
             const Shared & shared,
             const std::vector<Group> & groups,
             rng_t &) const {
-        const float shared_part =
-               + fast_lgamma(shared.alpha + shared.beta)
-               - fast_lgamma(shared.alpha)
-               - fast_lgamma(shared.beta);
+        count_t max_count = 0;
+        for (auto const & group : groups) {
+            max_count = std::max(max_count, group.heads + group.tails);
+        }
+        const auto table = shared.lgamma_table(
+            max_count + 1,
+            3 * groups.size());
+        const auto & lgamma = * table;
+
         float score = 0;
         for (auto const & group : groups) {
-            float alpha = shared.alpha + group.heads;
-            float beta = shared.beta + group.tails;
-            float group_part =
-                   + fast_lgamma(alpha)
-                   + fast_lgamma(beta)
-                   - fast_lgamma(alpha + beta);
-            score += shared_part + group_part;
+            score += lgamma.log_rising_factorial(
+                         Shared::lgamma_alpha, group.heads)
+                   + lgamma.log_rising_factorial(
+                         Shared::lgamma_beta, group.tails)
+                   - lgamma.log_rising_factorial(
+                         Shared::lgamma_alpha_beta, group.heads + group.tails);
         }
         return score;
     }
 };
 
 struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
+    enum { tabulate_when_frozen = true };
+
+    void frozen_domain(const Shared &, std::vector<Value> & values) const {
+        values = {false, true};
+    }
+
     void resize(const Shared &, size_t size) {
         heads_scores_.resize(size);
         tails_scores_.resize(size);
@@ -319,6 +340,32 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
         DIST_ASSERT_EQ(tails_scores_.size(), groups.size());
     }
 
+    template<class Writer>
+    void snapshot_dump(
+            const Shared & shared,
+            Writer & writer,
+            const std::string & prefix) const {
+        snapshot_dump_columns(
+            writer,
+            prefix,
+            {shared.alpha, shared.beta},
+            std::vector<const VectorFloat *>{& heads_scores_, & tails_scores_});
+    }
+
+    template<class Reader>
+    bool snapshot_load(
+            const Shared & shared,
+            const Reader & reader,
+            const std::string & prefix,
+            size_t group_count) {
+        return snapshot_load_columns(
+            reader,
+            prefix,
+            group_count,
+            {shared.alpha, shared.beta},
+            std::vector<VectorFloat *>{& heads_scores_, & tails_scores_});
+    }
+
  private:
     VectorFloat heads_scores_;
     VectorFloat tails_scores_;
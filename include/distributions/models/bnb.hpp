@@ -27,6 +27,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <distributions/common.hpp>
 #include <distributions/special.hpp>
@@ -34,6 +35,7 @@
 #include <distributions/vector.hpp>
 #include <distributions/mixins.hpp>
 #include <distributions/mixture.hpp>
+#include <distributions/parallel.hpp>
 
 namespace distributions {
 struct BetaNegativeBinomial {
@@ -53,6 +55,16 @@ struct Shared : SharedMixin<Model> {
     float alpha;
     float beta;
     uint32_t r;
+    LgammaOffsetCache lgamma_cache;
+
+    enum { lgamma_alpha, lgamma_beta, lgamma_alpha_beta };
+
+    LgammaOffsetCache::TablePtr lgamma_table(
+            size_t size,
+            size_t lookup_count) const {
+        const float offsets[] = {alpha, beta, alpha + beta};
+        return lgamma_cache.get(offsets, 3, size, lookup_count);
+    }
 
     Shared plus_group(const Group & group) const {
         Shared post;
@@ -87,8 +99,8 @@ struct Shared : SharedMixin<Model> {
 
 
 struct Group : GroupMixin<Model> {
-    uint32_t count;
-    uint32_t sum;
+    ucount_t count;
+    ucount_t sum;
 
     template<class Message>
     void protobuf_load(const Message & message) {
@@ -118,7 +130,7 @@ struct Group : GroupMixin<Model> {
     void add_repeated_value(
             const Shared &,
             const Value & value,
-            const int & count,
+            const count_t & count,
             rng_t &) {
         this->count += count;
         sum += count * value;
@@ -225,17 +237,29 @@ struct MixtureDataScorer
             const Shared & shared,
             const std::vector<Group> & groups,
             rng_t &) const {
-        const float shared_part = fast_lgamma(shared.alpha + shared.beta)
-                                - fast_lgamma(shared.alpha)
-                                - fast_lgamma(shared.beta);
+        // post.alpha = alpha + r * count, post.beta = beta + sum
+        const size_t r = shared.r;
+        size_t max_count = 0;
+        for (auto const & group : groups) {
+            max_count = std::max<size_t>(
+                max_count,
+                r * group.count + group.sum);
+        }
+        const auto table = shared.lgamma_table(
+            max_count + 1,
+            3 * groups.size());
+        const auto & lgamma = * table;
+
         float score = 0;
         for (auto const & group : groups) {
             if (group.count) {
-                Shared post = shared.plus_group(group);
-                score += fast_lgamma(post.alpha)
-                       + fast_lgamma(post.beta)
-                       - fast_lgamma(post.alpha + post.beta);
-                score += shared_part;
+                const size_t alpha_part = r * group.count;
+                score += lgamma.log_rising_factorial(
+                             Shared::lgamma_alpha, alpha_part)
+                       + lgamma.log_rising_factorial(
+                             Shared::lgamma_beta, group.sum)
+                       - lgamma.log_rising_factorial(
+                             Shared::lgamma_alpha_beta, alpha_part + group.sum);
             }
         }
         return score;
@@ -244,21 +268,15 @@ struct MixtureDataScorer
 
 struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
     void resize(const Shared &, size_t size) {
-        score_.resize(size);
-        post_beta_.resize(size);
-        alpha_.resize(size);
+        columns_.resize(size);
     }
 
     void add_group(const Shared &, rng_t &) {
-        score_.packed_add();
-        post_beta_.packed_add();
-        alpha_.packed_add();
+        columns_.packed_add();
     }
 
     void remove_group(const Shared &, size_t groupid) {
-        score_.packed_remove(groupid);
-        post_beta_.packed_remove(groupid);
-        alpha_.packed_remove(groupid);
+        columns_.packed_remove(groupid);
     }
 
     void update_group(
@@ -269,9 +287,9 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
         Model::Scorer base;
         base.init(shared, group, rng);
 
-        score_[groupid] = base.score;
-        post_beta_[groupid] = base.post_beta;
-        alpha_[groupid] = base.alpha;
+        columns_[score_column][groupid] = base.score;
+        columns_[post_beta_column][groupid] = base.post_beta;
+        columns_[alpha_column][groupid] = base.alpha;
     }
 
     void add_value(
@@ -296,10 +314,11 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
             const Shared & shared,
             const std::vector<Group> & groups,
             rng_t & rng) {
-        const size_t group_count = groups.size();
-        for (size_t groupid = 0; groupid < group_count; ++groupid) {
-            update_group(shared, groupid, groups[groupid], rng);
-        }
+        columns_.resize(groups.size());
+        parallel_for(0, groups.size(), min_parallel_work,
+            [this, &shared, &groups, &rng](size_t groupid) {
+                update_group(shared, groupid, groups[groupid], rng);
+            });
     }
 
     float score_value_group(
@@ -308,9 +327,10 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
             size_t groupid,
             const Value & value,
             rng_t &) const {
-        float beta = post_beta_[groupid] + value;
-        return score_[groupid] + fast_lgamma(beta)
-                               - fast_lgamma(beta + alpha_[groupid]);
+        float beta = columns_[post_beta_column][groupid] + value;
+        return columns_[score_column][groupid]
+             + fast_lgamma(beta)
+             - fast_lgamma(beta + columns_[alpha_column][groupid]);
     }
 
     void score_value(
@@ -319,25 +339,62 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
             const Value & value,
             AlignedFloats scores_accum,
             rng_t &) const {
+        const float * __restrict__ score =
+            VectorFloat_data(columns_[score_column]);
+        const float * __restrict__ post_beta =
+            VectorFloat_data(columns_[post_beta_column]);
+        const float * __restrict__ alpha =
+            VectorFloat_data(columns_[alpha_column]);
         for (size_t i = 0, size = scores_accum.size(); i < size; ++i) {
-            float beta = post_beta_[i] + value;
-            scores_accum[i] += score_[i] + fast_lgamma(beta)
-                                         - fast_lgamma(beta + alpha_[i]);
+            float beta = post_beta[i] + value;
+            scores_accum[i] += score[i] + fast_lgamma(beta)
+                                        - fast_lgamma(beta + alpha[i]);
         }
     }
 
     void validate(
             const Shared &,
             const std::vector<Group> & groups) const {
-        DIST_ASSERT_EQ(score_.size(), groups.size());
-        DIST_ASSERT_EQ(post_beta_.size(), groups.size());
-        DIST_ASSERT_EQ(alpha_.size(), groups.size());
+        DIST_ASSERT_EQ(columns_.size(), groups.size());
+    }
+
+    template<class Writer>
+    void snapshot_dump(
+            const Shared & shared,
+            Writer & writer,
+            const std::string & prefix) const {
+        columns_.snapshot_dump(writer, prefix, _fingerprint(shared));
+    }
+
+    template<class Reader>
+    bool snapshot_load(
+            const Shared & shared,
+            const Reader & reader,
+            const std::string & prefix,
+            size_t group_count) {
+        return columns_.snapshot_load(
+            reader,
+            prefix,
+            group_count,
+            _fingerprint(shared));
     }
 
  private:
-    VectorFloat score_;
-    VectorFloat post_beta_;
-    VectorFloat alpha_;
+    static std::vector<float> _fingerprint(const Shared & shared) {
+        return {shared.alpha, shared.beta, static_cast<float>(shared.r)};
+    }
+
+    enum {
+        score_column,
+        post_beta_column,
+        alpha_column,
+        column_count
+    };
+
+    // below this many groups, threading costs more than it saves
+    enum { min_parallel_work = 1 << 14 };
+
+    Columns_<column_count> columns_;
 };
 };  // struct BetaNegativeBinomial
 }   // namespace distributions
@@ -27,6 +27,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <distributions/common.hpp>
 #include <distributions/special.hpp>
@@ -35,6 +36,8 @@
 #include <distributions/vector_math.hpp>
 #include <distributions/mixins.hpp>
 #include <distributions/mixture.hpp>
+#include <distributions/io/repeated.hpp>
+#include <distributions/parallel.hpp>
 
 namespace distributions {
 template<int max_dim_>
@@ -42,7 +45,7 @@ struct DirichletDiscrete {
 enum { max_dim = max_dim_ };
 
 typedef DirichletDiscrete<max_dim> Model;
-typedef int count_t;
+typedef ::distributions::count_t count_t;
 typedef int Value;
 struct Group;
 struct Scorer;
@@ -57,22 +60,32 @@ typedef FastMixture Mixture;
 struct Shared : SharedMixin<Model> {
     int dim;  // fixed parameter
     float alphas[max_dim];  // hyperparamter
+    LgammaOffsetCache lgamma_cache;
+
+    // rows: alphas[0], ..., alphas[dim - 1], sum(alphas)
+    LgammaOffsetCache::TablePtr lgamma_table(
+            size_t size,
+            size_t lookup_count) const {
+        float offsets[max_dim + 1];
+        float alpha_sum = 0;
+        for (int i = 0; i < dim; ++i) {
+            alpha_sum += offsets[i] = alphas[i];
+        }
+        offsets[dim] = alpha_sum;
+        return lgamma_cache.get(offsets, dim + 1, size, lookup_count);
+    }
 
     template<class Message>
     void protobuf_load(const Message & message) {
         dim = message.alphas_size();
         DIST_ASSERT_LE(dim, max_dim);
-        for (int i = 0; i < dim; ++i) {
-            alphas[i] = message.alphas(i);
-        }
+        repeated_field_copy(message.alphas(), alphas);
     }
 
     template<class Message>
     void protobuf_dump(Message & message) const {
         message.Clear();
-        for (int i = 0; i < dim; ++i) {
-            message.add_alphas(alphas[i]);
-        }
+        repeated_field_assign(* message.mutable_alphas(), alphas, dim);
     }
 
     static Shared EXAMPLE() {
@@ -95,19 +108,17 @@ struct Group : GroupMixin<Model> {
     void protobuf_load(const Message & message) {
         dim = message.counts_size();
         DIST_ASSERT_LE(dim, max_dim);
+        repeated_field_copy(message.counts(), counts);
         count_sum = 0;
         for (int i = 0; i < dim; ++i) {
-            count_sum += counts[i] = message.counts(i);
+            count_sum += counts[i];
         }
     }
 
     template<class Message>
     void protobuf_dump(Message & message) const {
         message.Clear();
-        auto & message_counts = * message.mutable_counts();
-        for (int i = 0; i < dim; ++i) {
-            message_counts.Add(counts[i]);
-        }
+        repeated_field_assign(* message.mutable_counts(), counts, dim);
     }
 
     void init(
@@ -132,7 +143,7 @@ struct Group : GroupMixin<Model> {
     void add_repeated_value(
             const Shared &,
             const Value & value,
-            const int & count,
+            const count_t & count,
             rng_t &) {
         DIST_ASSERT1(value < dim, "value out of bounds: " << value);
         count_sum += count;
@@ -169,18 +180,16 @@ struct Group : GroupMixin<Model> {
     float score_data(
             const Shared & shared,
             rng_t &) const {
+        // one group reads too few entries to pay for building a table
         float score = 0;
         float alpha_sum = 0;
-
         for (Value value = 0; value < dim; ++value) {
-            float alpha = shared.alphas[value];
+            const float alpha = shared.alphas[value];
             alpha_sum += alpha;
-            score += fast_lgamma(alpha + counts[value])
-                   - fast_lgamma(alpha);
+            score += log_rising_factorial(alpha, counts[value]);
         }
 
-        score += fast_lgamma(alpha_sum)
-               - fast_lgamma(alpha_sum + count_sum);
+        score -= log_rising_factorial(alpha_sum, count_sum);
 
         return score;
     }
@@ -288,27 +297,31 @@ struct MixtureDataScorer
             const Shared & shared,
             const std::vector<Group> & groups) const {
         const size_t dim = shared.dim;
-        shared_part_.resize(dim + 1);
         float alpha_sum = 0;
         for (size_t i = 0; i < dim; ++i) {
-            float alpha = shared.alphas[i];
-            alpha_sum += alpha;
-            shared_part_[i] = fast_lgamma(alpha);
+            alpha_sum += shared.alphas[i];
         }
         alpha_sum_ = alpha_sum;
-        shared_part_.back() = fast_lgamma(alpha_sum);
+
+        count_t max_count_sum = 0;
+        for (auto const & group : groups) {
+            max_count_sum = std::max(max_count_sum, group.count_sum);
+        }
+        const auto table = shared.lgamma_table(
+            max_count_sum + 1,
+            (dim + 1) * groups.size());
+        const auto & lgamma = * table;
 
         scores_.resize(0);
         scores_.resize(dim + 1, 0);
         for (auto const & group : groups) {
             if (group.count_sum) {
                 for (size_t i = 0; i < dim; ++i) {
-                    float alpha = shared.alphas[i];
-                    scores_[i] += fast_lgamma(alpha + group.counts[i])
-                               - shared_part_[i];
+                    scores_[i] +=
+                        lgamma.log_rising_factorial(i, group.counts[i]);
                 }
-                scores_.back() += shared_part_.back()
-                               - fast_lgamma(alpha_sum + group.count_sum);
+                scores_.back() -=
+                    lgamma.log_rising_factorial(dim, group.count_sum);
             }
         }
     }
@@ -322,34 +335,43 @@ struct MixtureDataScorer
             float old_alpha,
             float new_alpha,
             const std::vector<Group> & groups) const {
-        shared_part_[value] = fast_lgamma(new_alpha);
         alpha_sum_ += static_cast<double>(new_alpha)
                     - static_cast<double>(old_alpha);
         const float alpha_sum = alpha_sum_;
-        shared_part_.back() = fast_lgamma(alpha_sum);
 
         scores_[value] = 0;
         scores_.back() = 0;
         for (auto const & group : groups) {
-            scores_[value] += fast_lgamma(new_alpha + group.counts[value])
-                           - shared_part_[value];
-            scores_.back() += shared_part_.back()
-                           - fast_lgamma(alpha_sum + group.count_sum);
+            scores_[value] +=
+                log_rising_factorial(new_alpha, group.counts[value]);
+            scores_.back() -=
+                log_rising_factorial(alpha_sum, group.count_sum);
         }
     }
 
     mutable double alpha_sum_;
-    mutable VectorFloat shared_part_;
     mutable VectorFloat scores_;
 };
 
 struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
+    enum { tabulate_when_frozen = true };
+
+    void frozen_domain(
+            const Shared & shared,
+            std::vector<Value> & values) const {
+        values.clear();
+        for (Value value = 0; value < shared.dim; ++value) {
+            values.push_back(value);
+        }
+    }
+
     void resize(const Shared & shared, size_t size) {
         scores_shift_.resize(size);
         scores_.resize(shared.dim);
-        for (Value value = 0; value < shared.dim; ++value) {
-            scores_[value].resize(size);
-        }
+        parallel_for(0, shared.dim, 1 + min_parallel_work / (1 + size),
+            [this, size](size_t value) {
+                scores_[value].resize(size);
+            });
     }
 
     void add_group(const Shared & shared, rng_t &) {
@@ -401,23 +423,31 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
             const std::vector<Group> & groups,
             rng_t &) {
         const size_t group_count = groups.size();
+        const Value dim = shared.dim;
 
         alpha_sum_ = 0;
-        for (Value value = 0; value < shared.dim; ++value) {
+        for (Value value = 0; value < dim; ++value) {
             alpha_sum_ += shared.alphas[value];
         }
-        for (size_t groupid = 0; groupid < group_count; ++groupid) {
-            const Group & group = groups[groupid];
-            for (Value value = 0; value < shared.dim; ++value) {
-                scores_[value][groupid] =
-                    shared.alphas[value] + group.counts[value];
-            }
-            scores_shift_[groupid] = alpha_sum_ + group.count_sum;
-        }
-        vector_log(group_count, scores_shift_.data());
-        for (Value value = 0; value < shared.dim; ++value) {
-            vector_log(group_count, scores_[value].data());
-        }
+
+        // each chunk of groups writes a disjoint slice of every column
+        const size_t min_chunk_size = 1 + min_parallel_work / (1 + dim);
+        parallel_for_chunks(0, group_count, min_chunk_size,
+            [this, &shared, &groups, dim](size_t begin, size_t end) {
+                for (size_t groupid = begin; groupid < end; ++groupid) {
+                    const Group & group = groups[groupid];
+                    for (Value value = 0; value < dim; ++value) {
+                        scores_[value][groupid] =
+                            shared.alphas[value] + group.counts[value];
+                    }
+                    scores_shift_[groupid] = alpha_sum_ + group.count_sum;
+                }
+                const size_t size = end - begin;
+                vector_log(size, scores_shift_.data() + begin);
+                for (Value value = 0; value < dim; ++value) {
+                    vector_log(size, scores_[value].data() + begin);
+                }
+            });
     }
 
     float score_value_group(
@@ -430,6 +460,19 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
         return scores_[value][groupid] - scores_shift_[groupid];
     }
 
+    float score_value_group_removed(
+            const Shared & shared,
+            const std::vector<Group> & groups,
+            size_t groupid,
+            const Value & value,
+            rng_t &) const {
+        DIST_ASSERT1(value < shared.dim, "value out of bounds: " << value);
+        const Group & group = groups[groupid];
+        return fast_log(
+            (shared.alphas[value] + group.counts[value] - 1) /
+            (alpha_sum_ + group.count_sum - 1));
+    }
+
     void score_value(
             const Shared & shared,
             const std::vector<Group> &,
@@ -454,7 +497,47 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
         DIST_ASSERT_EQ(scores_shift_.size(), groups.size());
     }
 
+    template<class Writer>
+    void snapshot_dump(
+            const Shared & shared,
+            Writer & writer,
+            const std::string & prefix) const {
+        std::vector<const VectorFloat *> columns;
+        for (Value value = 0; value < shared.dim; ++value) {
+            columns.push_back(& scores_[value]);
+        }
+        columns.push_back(& scores_shift_);
+        snapshot_dump_columns(writer, prefix, _fingerprint(shared), columns);
+    }
+
+    template<class Reader>
+    bool snapshot_load(
+            const Shared & shared,
+            const Reader & reader,
+            const std::string & prefix,
+            size_t group_count) {
+        std::vector<VectorFloat *> columns;
+        for (Value value = 0; value < shared.dim; ++value) {
+            columns.push_back(& scores_[value]);
+        }
+        columns.push_back(& scores_shift_);
+        alpha_sum_ = 0;
+        for (Value value = 0; value < shared.dim; ++value) {
+            alpha_sum_ += shared.alphas[value];
+        }
+        return snapshot_load_columns(
+            reader,
+            prefix,
+            group_count,
+            _fingerprint(shared),
+            columns);
+    }
+
  private:
+    static std::vector<float> _fingerprint(const Shared & shared) {
+        return std::vector<float>(shared.alphas, shared.alphas + shared.dim);
+    }
+
     void _update_group_value(
             const Shared & shared,
             size_t groupid,
@@ -466,6 +549,9 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
         scores_shift_[groupid] = fast_log(alpha_sum_ + group.count_sum);
     }
 
+    // below this many cells, threading costs more than it saves
+    enum { min_parallel_work = 1 << 14 };
+
     float alpha_sum_;
     std::vector<VectorFloat> scores_;
     VectorFloat scores_shift_;
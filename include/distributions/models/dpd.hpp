@@ -27,7 +27,9 @@
 
 #pragma once
 
+#include <string>
 #include <vector>
+#include <utility>
 #include <algorithm>
 #include <distributions/common.hpp>
 #include <distributions/special.hpp>
@@ -37,11 +39,13 @@
 #include <distributions/vector_math.hpp>
 #include <distributions/mixins.hpp>
 #include <distributions/mixture.hpp>
+#include <distributions/io/repeated.hpp>
+#include <distributions/parallel.hpp>
 
 namespace distributions {
 struct DirichletProcessDiscrete {
 typedef DirichletProcessDiscrete Model;
-typedef int count_t;
+typedef ::distributions::count_t count_t;
 typedef uint32_t Value;
 struct Group;
 struct Scorer;
@@ -111,6 +115,8 @@ struct Shared : SharedMixin<Model> {
         alpha = message.alpha();
         betas.clear();
         counts.clear();
+        betas.reserve(value_count);
+        counts.reserve(value_count);
         double beta_sum = 0;
         for (size_t i = 0; i < value_count; ++i) {
             auto value = message.values(i);
@@ -129,15 +135,28 @@ struct Shared : SharedMixin<Model> {
         message.Clear();
         message.set_gamma(gamma);
         message.set_alpha(alpha);
+        const size_t size = betas.size();
+        auto * __restrict__ values =
+            repeated_field_resize(* message.mutable_values(), size);
+        auto * __restrict__ message_betas =
+            repeated_field_resize(* message.mutable_betas(), size);
+        auto * __restrict__ message_counts =
+            repeated_field_resize(* message.mutable_counts(), size);
+        size_t pos = 0;
         for (auto & i : betas) {
-            auto value = i.first;
-            auto beta = i.second;
-            message.add_values(value);
-            message.add_betas(beta);
-            message.add_counts(counts.get_count(value));
+            values[pos] = i.first;
+            message_betas[pos] = i.second;
+            message_counts[pos] = counts.get_count(i.first);
+            ++pos;
         }
     }
 
+    // A compact alternative to protobuf_dump: values sorted and delta-coded
+    // as varints, then counts as varints, then betas rounded to beta_bytes
+    // of 2, 3 or 4 bytes each, where 4 is exact.  See io/varint.hpp.
+    void compact_dump(std::string & out, int beta_bytes = 4) const;
+    void compact_load(const std::string & in);
+
     static Shared EXAMPLE() {
         Shared shared;
         size_t dim = 100;
@@ -163,6 +182,7 @@ struct Group : GroupMixin<Model> {
             DIST_ASSERT_EQ(message.keys_size(), message.values_size());
         }
         counts.clear();
+        counts.reserve(message.keys_size());
         for (size_t i = 0, size = message.keys_size(); i < size; ++i) {
             counts.add(message.keys(i), message.values(i));
         }
@@ -171,14 +191,23 @@ struct Group : GroupMixin<Model> {
     template<class Message>
     void protobuf_dump(Message & message) const {
         message.Clear();
-        auto & keys = * message.mutable_keys();
-        auto & values = * message.mutable_values();
+        const size_t size = counts.size();
+        auto * __restrict__ keys =
+            repeated_field_resize(* message.mutable_keys(), size);
+        auto * __restrict__ values =
+            repeated_field_resize(* message.mutable_values(), size);
+        size_t pos = 0;
         for (auto const & pair : counts) {
-            keys.Add(pair.first);
-            values.Add(pair.second);
+            keys[pos] = pair.first;
+            values[pos] = pair.second;
+            ++pos;
         }
     }
 
+    // like Shared::compact_dump, with keys then counts
+    void compact_dump(std::string & out) const;
+    void compact_load(const std::string & in);
+
     void init(
             const Shared &,
             rng_t &) {
@@ -197,7 +226,7 @@ struct Group : GroupMixin<Model> {
     void add_repeated_value(
             const Shared & shared,
             const Value & value,
-            const int & count,
+            const count_t & count,
             rng_t &) {
         DIST_ASSERT1(value != OTHER(), "cannot add OTHER");
         DIST_ASSERT1(shared.betas.contains(value), "unknown value: " << value);
@@ -235,18 +264,17 @@ struct Group : GroupMixin<Model> {
     float score_data(
             const Shared & shared,
             rng_t &) const {
-        const size_t total = counts.get_total();
+        const count_t total = counts.get_total();
         const float alpha = shared.alpha;
 
+        // counts may be negative while the group is in data debt
         float score = 0;
         for (auto & i : counts) {
             Value value = i.first;
             float prior_i = alpha * shared.betas.get(value);
-            score += fast_lgamma(prior_i + i.second)
-                   - fast_lgamma(prior_i);
+            score += signed_log_rising_factorial(prior_i, i.second);
         }
-        score += fast_lgamma(alpha)
-               - fast_lgamma(alpha + total);
+        score -= signed_log_rising_factorial(alpha, total);
 
         return score;
     }
@@ -349,23 +377,17 @@ struct MixtureDataScorer
             rng_t &) const {
         const float alpha = shared.alpha;
 
-        Sparse_<Value, float> shared_part;
-        for (auto & i : shared.betas) {
-            shared_part.add(i.first, fast_lgamma(alpha * i.second));
-        }
-        const float shared_total = fast_lgamma(alpha);
-
         float score = 0;
         for (auto const & group : groups) {
             if (group.counts.get_total()) {
                 for (auto & i : group.counts) {
                     Value value = i.first;
                     float prior_i = shared.betas.get(value) * alpha;
-                    score += fast_lgamma(prior_i + i.second)
-                           - shared_part.get(value);
+                    score += signed_log_rising_factorial(prior_i, i.second);
                 }
-                score += shared_total
-                       - fast_lgamma(alpha + group.counts.get_total());
+                score -= signed_log_rising_factorial(
+                    alpha,
+                    group.counts.get_total());
             }
         }
 
@@ -374,14 +396,36 @@ struct MixtureDataScorer
 };
 
 struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
+    // add_value/remove_value maintain per-value ref counts
+    enum { supports_deferred_updates = false };
+
+    enum { tabulate_when_frozen = true };
+
+    void frozen_domain(
+            const Shared & shared,
+            std::vector<Value> & values) const {
+        values.clear();
+        values.reserve(shared.betas.size() + 1);
+        for (auto const & i : shared.betas) {
+            values.push_back(i.first);
+        }
+        values.push_back(OTHER());
+    }
+
     void resize(const Shared & shared, size_t size) {
         scores_shift_.resize(size);
+        std::vector<CountAndScores *> entries;
+        entries.reserve(shared.betas.size());
         for (auto const & i : shared.betas) {
             Value value = i.first;
             auto & entry = scores_.get_or_add(value);
             entry.ref_count = 1;
-            entry.scores.resize(size);
+            entries.push_back(& entry);
         }
+        parallel_for(0, entries.size(), 1 + min_parallel_work / (1 + size),
+            [&entries, size](size_t i) {
+                entries[i]->scores.resize(size);
+            });
         if (scores_.size() != shared.betas.size()) {
             for (auto i = scores_.begin(); i != scores_.end();) {
                 if (DIST_UNLIKELY(not shared.betas.contains(i->first))) {
@@ -476,24 +520,52 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
         const size_t group_count = groups.size();
         const float alpha = shared.alpha;
 
+        std::vector<std::pair<float, CountAndScores *>> entries;
+        entries.reserve(scores_.size());
         for (auto & i : scores_) {
-            Value value = i.first;
-            auto & entry = i.second;
-            entry.ref_count = 0;
-            const float beta = shared.betas.get(value);
-            for (size_t groupid = 0; groupid < group_count; ++groupid) {
-                auto count = groups[groupid].counts.get_count(value);
-                entry.ref_count += count;
-                entry.scores[groupid] = alpha * beta + count;
-            }
-            vector_log(group_count, entry.scores.data());
-        }
+            const float beta = shared.betas.get(i.first);
+            entries.push_back(std::make_pair(alpha * beta, & i.second));
+        }
+        const size_t min_chunk_size =
+            1 + min_parallel_work / (1 + group_count);
+
+        // start every column at its prior pseudocount
+        parallel_for(0, entries.size(), min_chunk_size,
+            [&entries, group_count](size_t i) {
+                auto & entry = * entries[i].second;
+                entry.ref_count = 0;
+                float * __restrict__ scores = VectorFloat_data(entry.scores);
+                const float prior = entries[i].first;
+                for (size_t groupid = 0; groupid < group_count; ++groupid) {
+                    scores[groupid] = prior;
+                }
+            });
 
+        // scatter only the nonzero counts, rather than probing every
+        // (value, group) pair
         for (size_t groupid = 0; groupid < group_count; ++groupid) {
-            auto total = groups[groupid].counts.get_total();
-            scores_shift_[groupid] = alpha + total;
+            for (auto const & i : groups[groupid].counts) {
+                if (DIST_LIKELY(scores_.contains(i.first))) {
+                    auto & entry = scores_.get(i.first);
+                    entry.ref_count += i.second;
+                    entry.scores[groupid] += i.second;
+                }
+            }
         }
-        vector_log(group_count, scores_shift_.data());
+
+        parallel_for(0, entries.size(), min_chunk_size,
+            [&entries, group_count](size_t i) {
+                vector_log(group_count, entries[i].second->scores.data());
+            });
+
+        parallel_for_chunks(0, group_count, min_parallel_work,
+            [this, &groups, alpha](size_t begin, size_t end) {
+                for (size_t groupid = begin; groupid < end; ++groupid) {
+                    auto total = groups[groupid].counts.get_total();
+                    scores_shift_[groupid] = alpha + total;
+                }
+                vector_log(end - begin, scores_shift_.data() + begin);
+            });
     }
 
     float score_value_group(
@@ -514,6 +586,21 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
         }
     }
 
+    float score_value_group_removed(
+            const Shared & shared,
+            const std::vector<Group> & groups,
+            size_t groupid,
+            const Value & value,
+            rng_t &) const {
+        DIST_ASSERT1(value != OTHER(), "cannot remove OTHER");
+        const Group & group = groups[groupid];
+        const float alpha = shared.alpha;
+        const float numer = alpha * shared.betas.get(value)
+                          + (group.counts.get_count(value) - 1);
+        const float denom = alpha + (group.counts.get_total() - 1);
+        return fast_log(numer / denom);
+    }
+
     void score_value(
             const Shared & shared,
             const std::vector<Group> & groups,
@@ -573,6 +660,10 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
         VectorFloat scores;
         CountAndScores() : ref_count(0), scores() {}
     };
+
+    // below this many cells, threading costs more than it saves
+    enum { min_parallel_work = 1 << 14 };
+
     Sparse_<Value, CountAndScores> scores_;
     VectorFloat scores_shift_;
 };
@@ -27,6 +27,7 @@
 
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <distributions/common.hpp>
 #include <distributions/special.hpp>
@@ -34,6 +35,7 @@
 #include <distributions/vector.hpp>
 #include <distributions/mixins.hpp>
 #include <distributions/mixture.hpp>
+#include <distributions/parallel.hpp>
 
 namespace distributions {
 struct GammaPoisson {
@@ -52,6 +54,13 @@ typedef FastMixture Mixture;
 struct Shared : SharedMixin<Model> {
     float alpha;
     float inv_beta;
+    LgammaOffsetCache lgamma_cache;
+
+    LgammaOffsetCache::TablePtr lgamma_table(
+            size_t size,
+            size_t lookup_count) const {
+        return lgamma_cache.get(&alpha, 1, size, lookup_count);
+    }
 
     Shared plus_group(const Group & group) const {
         Shared post;
@@ -82,8 +91,8 @@ struct Shared : SharedMixin<Model> {
 
 
 struct Group : GroupMixin<Model> {
-    uint32_t count;
-    uint32_t sum;
+    ucount_t count;
+    ucount_t sum;
     float log_prod;
 
     template<class Message>
@@ -118,7 +127,7 @@ struct Group : GroupMixin<Model> {
     void add_repeated_value(
             const Shared &,
             const Value & value,
-            const int & count,
+            const count_t & count,
             rng_t &) {
         this->count += count;
         sum += count * value;
@@ -223,14 +232,20 @@ struct MixtureDataScorer
             const Shared & shared,
             const std::vector<Group> & groups,
             rng_t &) const {
-        const float alpha_part = fast_lgamma(shared.alpha);
+        ucount_t max_sum = 0;
+        for (auto const & group : groups) {
+            max_sum = std::max(max_sum, group.sum);
+        }
+        const auto table = shared.lgamma_table(max_sum + 1, groups.size());
+        const auto & lgamma = * table;
+
         const float beta_part = shared.alpha * fast_log(shared.inv_beta);
 
         float score = 0;
         for (auto const & group : groups) {
             if (group.count) {
                 Shared post = shared.plus_group(group);
-                score += fast_lgamma(post.alpha) - alpha_part;
+                score += lgamma.log_rising_factorial(0, group.sum);
                 score += beta_part - post.alpha * fast_log(post.inv_beta);
                 score += -group.log_prod;
             }
@@ -242,21 +257,15 @@ struct MixtureDataScorer
 
 struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
     void resize(const Shared &, size_t size) {
-        score_.resize(size);
-        post_alpha_.resize(size);
-        score_coeff_.resize(size);
+        columns_.resize(size);
     }
 
     void add_group(const Shared &, rng_t &) {
-        score_.packed_add();
-        post_alpha_.packed_add();
-        score_coeff_.packed_add();
+        columns_.packed_add();
     }
 
     void remove_group(const Shared &, size_t groupid) {
-        score_.packed_remove(groupid);
-        post_alpha_.packed_remove(groupid);
-        score_coeff_.packed_remove(groupid);
+        columns_.packed_remove(groupid);
     }
 
     void update_group(
@@ -267,9 +276,9 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
         Model::Scorer base;
         base.init(shared, group, rng);
 
-        score_[groupid] = base.score;
-        post_alpha_[groupid] = base.post_alpha;
-        score_coeff_[groupid] = base.score_coeff;
+        columns_[score_column][groupid] = base.score;
+        columns_[post_alpha_column][groupid] = base.post_alpha;
+        columns_[score_coeff_column][groupid] = base.score_coeff;
     }
 
     void add_value(
@@ -293,12 +302,7 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
     void update_all(
             const Shared & shared,
             const std::vector<Group> & groups,
-            rng_t & rng) {
-        const size_t group_count = groups.size();
-        for (size_t groupid = 0; groupid < group_count; ++groupid) {
-            update_group(shared, groupid, groups[groupid], rng);
-        }
-    }
+            rng_t & rng);
 
     float score_value_group(
             const Shared &,
@@ -306,10 +310,10 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
             size_t groupid,
             const Value & value,
             rng_t &) const {
-        return score_[groupid]
-            + fast_lgamma(post_alpha_[groupid] + value)
+        return columns_[score_column][groupid]
+            + fast_lgamma(columns_[post_alpha_column][groupid] + value)
             - fast_log_factorial(value)
-            + score_coeff_[groupid] * value;
+            + columns_[score_coeff_column][groupid] * value;
     }
 
     void score_value(
@@ -322,15 +326,46 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
     void validate(
             const Shared &,
             const std::vector<Group> & groups) const {
-        DIST_ASSERT_EQ(score_.size(), groups.size());
-        DIST_ASSERT_EQ(post_alpha_.size(), groups.size());
-        DIST_ASSERT_EQ(score_coeff_.size(), groups.size());
+        DIST_ASSERT_EQ(columns_.size(), groups.size());
+    }
+
+    template<class Writer>
+    void snapshot_dump(
+            const Shared & shared,
+            Writer & writer,
+            const std::string & prefix) const {
+        columns_.snapshot_dump(writer, prefix, _fingerprint(shared));
+    }
+
+    template<class Reader>
+    bool snapshot_load(
+            const Shared & shared,
+            const Reader & reader,
+            const std::string & prefix,
+            size_t group_count) {
+        return columns_.snapshot_load(
+            reader,
+            prefix,
+            group_count,
+            _fingerprint(shared));
     }
 
  private:
-    VectorFloat score_;
-    VectorFloat post_alpha_;
-    VectorFloat score_coeff_;
+    static std::vector<float> _fingerprint(const Shared & shared) {
+        return {shared.alpha, shared.inv_beta};
+    }
+
+    enum {
+        score_column,
+        post_alpha_column,
+        score_coeff_column,
+        column_count
+    };
+
+    // below this many groups, threading costs more than it saves
+    enum { min_parallel_work = 1 << 14 };
+
+    Columns_<column_count> columns_;
 };
 };  // struct GammaPoisson
 }   // namespace distributions
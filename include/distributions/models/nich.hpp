@@ -34,6 +34,7 @@
 #include <distributions/vector.hpp>
 #include <distributions/mixins.hpp>
 #include <distributions/mixture.hpp>
+#include <distributions/parallel.hpp>
 
 namespace distributions {
 struct NormalInverseChiSq {
@@ -96,7 +97,7 @@ struct Shared : SharedMixin<Model> {
 
 
 struct Group : GroupMixin<Model> {
-    int count;
+    count_t count;
     float mean;
     float count_times_variance;
 
@@ -135,7 +136,7 @@ struct Group : GroupMixin<Model> {
     void add_repeated_value(
             const Shared &,
             const Value & value,
-            const int & count,
+            const count_t & count,
             rng_t &) {
         this->count += count;
         float delta = count * value - mean;
@@ -289,24 +290,15 @@ struct MixtureDataScorer
 
 struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
     void resize(const Shared &, size_t size) {
-        score_.resize(size);
-        log_coeff_.resize(size);
-        precision_.resize(size);
-        mean_.resize(size);
+        columns_.resize(size);
     }
 
     void add_group(const Shared &, rng_t &) {
-        score_.packed_add();
-        log_coeff_.packed_add();
-        precision_.packed_add();
-        mean_.packed_add();
+        columns_.packed_add();
     }
 
     void remove_group(const Shared &, size_t groupid) {
-        score_.packed_remove(groupid);
-        log_coeff_.packed_remove(groupid);
-        precision_.packed_remove(groupid);
-        mean_.packed_remove(groupid);
+        columns_.packed_remove(groupid);
     }
 
     void update_group(
@@ -317,10 +309,10 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
         Model::Scorer base;
         base.init(shared, group, rng);
 
-        score_[groupid] = base.score;
-        log_coeff_[groupid] = base.log_coeff;
-        precision_[groupid] = base.precision;
-        mean_[groupid] = base.mean;
+        columns_[score_column][groupid] = base.score;
+        columns_[log_coeff_column][groupid] = base.log_coeff;
+        columns_[precision_column][groupid] = base.precision;
+        columns_[mean_column][groupid] = base.mean;
     }
 
     void add_value(
@@ -344,12 +336,7 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
     void update_all(
             const Shared & shared,
             const std::vector<Group> & groups,
-            rng_t & rng) {
-        const size_t group_count = groups.size();
-        for (size_t groupid = 0; groupid < group_count; ++groupid) {
-            update_group(shared, groupid, groups[groupid], rng);
-        }
-    }
+            rng_t & rng);
 
     float score_value_group(
             const Shared &,
@@ -357,8 +344,10 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
             size_t groupid,
             const Value & value,
             rng_t &) const {
-        float temp = 1.f + precision_[groupid] * sqr(value - mean_[groupid]);
-        return score_[groupid] + log_coeff_[groupid] * fast_log(temp);
+        float temp = 1.f + columns_[precision_column][groupid]
+                         * sqr(value - columns_[mean_column][groupid]);
+        return columns_[score_column][groupid]
+             + columns_[log_coeff_column][groupid] * fast_log(temp);
     }
 
     void score_value(
@@ -371,17 +360,47 @@ struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
     void validate(
             const Shared &,
             const std::vector<Group> & groups) const {
-        DIST_ASSERT_EQ(score_.size(), groups.size());
-        DIST_ASSERT_EQ(log_coeff_.size(), groups.size());
-        DIST_ASSERT_EQ(precision_.size(), groups.size());
-        DIST_ASSERT_EQ(mean_.size(), groups.size());
+        DIST_ASSERT_EQ(columns_.size(), groups.size());
+    }
+
+    template<class Writer>
+    void snapshot_dump(
+            const Shared & shared,
+            Writer & writer,
+            const std::string & prefix) const {
+        columns_.snapshot_dump(writer, prefix, _fingerprint(shared));
+    }
+
+    template<class Reader>
+    bool snapshot_load(
+            const Shared & shared,
+            const Reader & reader,
+            const std::string & prefix,
+            size_t group_count) {
+        return columns_.snapshot_load(
+            reader,
+            prefix,
+            group_count,
+            _fingerprint(shared));
     }
 
  private:
-    VectorFloat score_;
-    VectorFloat log_coeff_;
-    VectorFloat precision_;
-    VectorFloat mean_;
+    static std::vector<float> _fingerprint(const Shared & shared) {
+        return {shared.mu, shared.kappa, shared.sigmasq, shared.nu};
+    }
+
+    enum {
+        score_column,
+        log_coeff_column,
+        precision_column,
+        mean_column,
+        column_count
+    };
+
+    // below this many groups, threading costs more than it saves
+    enum { min_parallel_work = 1 << 14 };
+
+    Columns_<column_count> columns_;
 };
 };  // struct NormalInverseChiSq
 }   // namespace distributions
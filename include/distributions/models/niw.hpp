@@ -34,6 +34,7 @@
 #include <distributions/vector_math.hpp>
 #include <distributions/mixins.hpp>
 #include <distributions/mixture.hpp>
+#include <distributions/io/repeated.hpp>
 
 #include <eigen3/Eigen/Dense>
 #include <eigen3/Eigen/Cholesky>
@@ -66,12 +67,18 @@ static_assert(dim_ == -1 || dim_ > 0, "invalid dimension");
 
 typedef Eigen::Matrix<float, dim_, dim_> Matrix;
 typedef Eigen::Matrix<float, dim_, 1> Vector;
+typedef Eigen::Matrix<float, dim_, dim_, Eigen::RowMajor> RowMajorMatrix;
 
 typedef NormalInverseWishart<dim_> Model;
 typedef Vector Value;
 struct Group;
 struct Scorer;
 struct Sampler;
+struct MixtureDataScorer;
+struct MixtureValueScorer;
+typedef MixtureSlave<Model> SmallMixture;
+typedef MixtureSlave<Model, MixtureDataScorer, MixtureValueScorer> FastMixture;
+typedef FastMixture Mixture;
 
 struct Shared : SharedMixin<Model> {
     Vector mu;
@@ -108,9 +115,7 @@ struct Shared : SharedMixin<Model> {
         const size_t dim = message.mu_size();
         check_row_or_col_size(dim);
         mu.resize(dim, Eigen::NoChange);
-        for (size_t i = 0; i < dim; i++) {
-            mu(i) = message.mu(i);
-        }
+        repeated_field_copy(message.mu(), mu.data());
 
         // kappa
         DIST_ASSERT_GT(message.kappa(), 0.);
@@ -118,12 +123,7 @@ struct Shared : SharedMixin<Model> {
 
         // psi
         check_rowcol_size(dim, message.psi_size());
-        psi.resize(dim, dim);
-        for (size_t i = 0; i < dim; i++) {
-            for (size_t j = 0; j < dim; j++) {
-                psi(i, j) = message.psi(i * dim + j);
-            }
-        }
+        psi = Eigen::Map<const RowMajorMatrix>(message.psi().data(), dim, dim);
         DIST_ASSERT3(is_symmetric_positive_definite(psi),
                      "expected SPD matrix");
         DIST_ASSERT_EQ(mu.rows(), psi.rows());
@@ -137,20 +137,14 @@ struct Shared : SharedMixin<Model> {
     void protobuf_dump(Message & message) const {
         message.Clear();
 
-        const size_t mu_size = mu.size();
-        for (size_t i = 0; i < mu_size; i++) {
-            message.add_mu(mu(i));
-        }
+        repeated_field_assign(* message.mutable_mu(), mu.data(), mu.size());
 
         message.set_kappa(kappa);
 
-        const size_t psi_rows = psi.rows();
-        const size_t psi_cols = psi.cols();
-        for (size_t i = 0; i < psi_rows; i++) {
-            for (size_t j = 0; j < psi_cols; j++) {
-                message.add_psi(psi(i, j));
-            }
-        }
+        Eigen::Map<RowMajorMatrix>(
+            repeated_field_resize(* message.mutable_psi(), psi.size()),
+            psi.rows(),
+            psi.cols()) = psi;
 
         message.set_nu(nu);
     }
@@ -185,7 +179,7 @@ struct Shared : SharedMixin<Model> {
 };
 
 struct Group : GroupMixin<Model> {
-    int count;
+    count_t count;
     Vector sum_x;
     Matrix sum_xxT;
 
@@ -198,18 +192,12 @@ struct Group : GroupMixin<Model> {
         const size_t dim = message.sum_x_size();
         Shared::check_row_or_col_size(dim);
         sum_x.resize(dim, Eigen::NoChange);
-        for (size_t i = 0; i < dim; i++) {
-            sum_x(i) = message.sum_x(i);
-        }
+        repeated_field_copy(message.sum_x(), sum_x.data());
 
         // sum_xxT
         Shared::check_rowcol_size(dim, message.sum_xxt_size());
-        sum_xxT.resize(dim, dim);
-        for (size_t i = 0; i < dim; i++) {
-            for (size_t j = 0; j < dim; j++) {
-                sum_xxT(i, j) = message.sum_xxt(i * dim + j);
-            }
-        }
+        sum_xxT = Eigen::Map<const RowMajorMatrix>(
+            message.sum_xxt().data(), dim, dim);
         // XXX(stephentu): should also assert positive semi-definite
         DIST_ASSERT3(is_symmetric(sum_xxT), "expected sym matrix");
         DIST_ASSERT_EQ(sum_x.rows(), sum_xxT.rows());
@@ -218,19 +206,18 @@ struct Group : GroupMixin<Model> {
     template<class Message>
     void protobuf_dump(Message & message) const {
         message.Clear();
+        DIST_ASSERT(
+            static_cast<int32_t>(count) == count,
+            "count overflows the int32 protobuf field: " << count);
         message.set_count(count);
-        const size_t sum_x_size = sum_x.size();
-        for (size_t i = 0; i < sum_x_size; i++) {
-            message.add_sum_x(sum_x(i));
-        }
-
-        const size_t sum_xxT_rows = sum_xxT.rows();
-        const size_t sum_xxT_cols = sum_xxT.cols();
-        for (size_t i = 0; i < sum_xxT_rows; i++) {
-            for (size_t j = 0; j < sum_xxT_cols; j++) {
-                message.add_sum_xxt(sum_xxT(i, j));
-            }
-        }
+        repeated_field_assign(
+            * message.mutable_sum_x(),
+            sum_x.data(),
+            sum_x.size());
+        Eigen::Map<RowMajorMatrix>(
+            repeated_field_resize(* message.mutable_sum_xxt(), sum_xxT.size()),
+            sum_xxT.rows(),
+            sum_xxT.cols()) = sum_xxT;
     }
 
     void init(
@@ -257,12 +244,13 @@ struct Group : GroupMixin<Model> {
     void add_repeated_value(
             const Shared & shared,
             const Value & value,
-            const int & count,
+            const count_t & count,
             rng_t &) {
         DIST_ASSERT3(shared.dim() == (size_t)value.size(), "dim mismatch");
+        const float weight = count;
         this->count += count;
-        sum_x += count * value;
-        sum_xxT += count * (value * value.transpose());
+        sum_x += weight * value;
+        sum_xxT += weight * (value * value.transpose());
     }
 
     void remove_value(
@@ -299,10 +287,10 @@ struct Group : GroupMixin<Model> {
         Shared post = shared.plus_group(*this);
         const float log_pi = 1.1447298858494002;
         return lmultigamma(shared.dim(), post.nu * 0.5)
-            + shared.nu * 0.5 * fast_log(shared.psi.determinant())
+            + shared.nu * 0.5 * spd_log_det(shared.psi)
             - static_cast<float>(count * shared.dim()) * 0.5 * log_pi
             - lmultigamma(shared.dim(), shared.nu * 0.5)
-            - post.nu * 0.5 * fast_log(post.psi.determinant())
+            - post.nu * 0.5 * spd_log_det(post.psi)
             + static_cast<float>(shared.dim())
               * 0.5 * fast_log(shared.kappa / post.kappa);
     }
@@ -320,44 +308,309 @@ struct Group : GroupMixin<Model> {
 
 struct Sampler {
     Vector mu;
-    Matrix cov;
+    Matrix factor;  // cov = factor * factor^T
 
     void init(
             const Shared & shared,
             const Group & group,
             rng_t & rng) {
         Shared post = shared.plus_group(group);
-        auto p = sample_normal_inverse_wishart(
+        auto p = sample_normal_inverse_wishart_factor(
                 post.mu, post.kappa, post.psi, post.nu, rng);
         mu.swap(p.first);
-        cov.swap(p.second);
+        factor.swap(p.second);
     }
 
     Value eval(
             const Shared &,
             rng_t & rng) const {
-        return sample_multivariate_normal(mu, cov, rng);
+        return sample_multivariate_normal_factor(mu, factor, rng);
+    }
+
+    // fills one value per row of values_out
+    template<class Values>
+    void eval_many(
+            const Shared &,
+            size_t count,
+            Eigen::MatrixBase<Values> & values_out,
+            rng_t & rng) const {
+        const size_t dim = mu.size();
+        Eigen::Matrix<float, Eigen::Dynamic, dim_> z(count, dim);
+        std::normal_distribution<float> norm;
+        for (size_t j = 0; j < dim; ++j) {
+            for (size_t i = 0; i < count; ++i) {
+                z(i, j) = norm(rng);
+            }
+        }
+        values_out.derived().resize(count, dim);
+        values_out.noalias() = z * factor.transpose();
+        values_out.rowwise() += mu.transpose();
     }
 };
 
 struct Scorer {
-    Shared post;
+    Vector mu;
+    Matrix l;
+    float score;
+    float log_coeff;
+    float precision;
 
     void init(
             const Shared & shared,
             const Group & group,
             rng_t &) {
-        post = shared.plus_group(group);
+        const Shared post = shared.plus_group(group);
+        DIST_ASSERT(cholesky_factor(post.psi, l), "expected SPD matrix");
+        mu = post.mu;
+        const float d = shared.dim();
+        const float dof = post.nu - d + 1.f;
+        const float log_det_sigma = cholesky_log_det(l)
+            + d * fast_log((post.kappa + 1.f) / (post.kappa * dof));
+        score = mv_student_t_log_normalizer(shared.dim(), dof, log_det_sigma);
+        log_coeff = -0.5f * (dof + d);
+        precision = post.kappa / (post.kappa + 1.f);
     }
 
     float eval(
+            const Shared &,
+            const Value & value,
+            rng_t &) const {
+        const Vector diff = value - mu;
+        return score + log_coeff * fast_log(
+            1.f + precision * cholesky_mahalanobis(l, diff));
+    }
+
+    template<class Alloc>
+    void eval_many(
+            const Shared &,
+            const std::vector<Value, Alloc> & values,
+            AlignedFloats scores_out,
+            rng_t &) const {
+        DIST_ASSERT_EQ(values.size(), scores_out.size());
+        const size_t size = values.size();
+        float * __restrict__ scores = scores_out.data();
+        for (size_t i = 0; i < size; ++i) {
+            const Vector diff = values[i] - mu;
+            scores[i] = 1.f + precision * cholesky_mahalanobis(l, diff);
+        }
+        vector_log(size, scores);
+        for (size_t i = 0; i < size; ++i) {
+            scores[i] = score + log_coeff * scores[i];
+        }
+    }
+};
+
+struct MixtureDataScorer
+    : MixtureSlaveDataScorerMixin<Model, MixtureDataScorer> {
+    float score_data(
             const Shared & shared,
+            const std::vector<Group> & groups,
+            rng_t &) const {
+        const unsigned dim = shared.dim();
+        const float d = dim;
+        const float log_pi = 1.1447298858494002;
+        const float shared_part =
+            0.5f * shared.nu * spd_log_det(shared.psi)
+            - lmultigamma(dim, 0.5f * shared.nu);
+        const float kappa_part = 0.5f * d * fast_log(shared.kappa);
+
+        float score = 0;
+        for (auto const & group : groups) {
+            if (group.count) {
+                const Shared post = shared.plus_group(group);
+                score += shared_part + kappa_part
+                    + lmultigamma(dim, 0.5f * post.nu)
+                    - 0.5f * post.nu * spd_log_det(post.psi)
+                    - 0.5f * d * fast_log(post.kappa)
+                    - 0.5f * d * log_pi * group.count;
+            }
+        }
+
+        return score;
+    }
+};
+
+struct MixtureValueScorer : MixtureSlaveValueScorerMixin<Model> {
+    void resize(const Shared & shared, size_t size) {
+        columns_.resize(size);
+        posts_.resize(size, _posterior(shared));
+    }
+
+    void add_group(const Shared & shared, rng_t &) {
+        columns_.packed_add();
+        posts_.packed_add(_posterior(shared));
+    }
+
+    void remove_group(const Shared &, size_t groupid) {
+        columns_.packed_remove(groupid);
+        posts_.packed_remove(groupid);
+    }
+
+    void update_group(
+            const Shared & shared,
+            size_t groupid,
+            const Group & group,
+            rng_t &) {
+        posts_[groupid] = _posterior(shared.plus_group(group));
+        _update_score(shared, groupid);
+    }
+
+    // psi += kappa / (kappa + 1) * (x - mu) (x - mu)^T
+    void add_value(
+            const Shared & shared,
+            size_t groupid,
+            const Group & group,
             const Value & value,
+            rng_t & rng) {
+        Posterior & post = posts_[groupid];
+        const Vector diff = value - post.mu;
+        const float scale = post.kappa / (post.kappa + 1.f);
+        if (DIST_UNLIKELY(++post.rank_updates > max_rank_updates) or
+                DIST_UNLIKELY(not cholesky_rank_update(post.l, diff, scale))) {
+            update_group(shared, groupid, group, rng);
+            return;
+        }
+        post.mu += diff / (post.kappa + 1.f);
+        post.kappa += 1.f;
+        post.nu += 1.f;
+        _update_score(shared, groupid);
+    }
+
+    // psi -= kappa / (kappa - 1) * (x - mu) (x - mu)^T
+    void remove_value(
+            const Shared & shared,
+            size_t groupid,
+            const Group & group,
+            const Value & value,
+            rng_t & rng) {
+        Posterior & post = posts_[groupid];
+        if (DIST_LIKELY(group.count) and
+                DIST_LIKELY(++post.rank_updates <= max_rank_updates)) {
+            const Vector diff = value - post.mu;
+            const float scale = -post.kappa / (post.kappa - 1.f);
+            if (DIST_LIKELY(cholesky_rank_update(post.l, diff, scale))) {
+                post.mu -= diff / (post.kappa - 1.f);
+                post.kappa -= 1.f;
+                post.nu -= 1.f;
+                _update_score(shared, groupid);
+                return;
+            }
+        }
+        // refactor when the group empties, the downdate loses precision,
+        // or rounding errors have accumulated for too long
+        update_group(shared, groupid, group, rng);
+    }
+
+    void update_all(
+            const Shared & shared,
+            const std::vector<Group> & groups,
+            rng_t & rng) {
+        const size_t group_count = groups.size();
+        for (size_t groupid = 0; groupid < group_count; ++groupid) {
+            update_group(shared, groupid, groups[groupid], rng);
+        }
+    }
+
+    float score_value_group(
+            const Shared &,
+            const std::vector<Group> &,
+            size_t groupid,
+            const Value & value,
+            rng_t &) const {
+        const float temp = 1.f + columns_[precision_column][groupid]
+                         * _mahalanobis(posts_[groupid], value);
+        return columns_[score_column][groupid]
+             + columns_[log_coeff_column][groupid] * fast_log(temp);
+    }
+
+    void score_value(
+            const Shared &,
+            const std::vector<Group> &,
+            const Value & value,
+            AlignedFloats scores_accum,
             rng_t &) const {
-        const float dof = post.nu - static_cast<float>(shared.dim()) + 1.;
-        const Matrix sigma = post.psi * (post.kappa + 1.) / (post.kappa * dof);
-        return score_mv_student_t(value, dof, post.mu, sigma);
+        const size_t size = scores_accum.size();
+
+        static thread_local VectorFloat * temp_ = nullptr;
+        if (DIST_UNLIKELY(not temp_)) {
+            temp_ = new VectorFloat(size);  // never freed
+        } else {
+            temp_->resize(size);
+        }
+
+        const float * __restrict__ score =
+            VectorFloat_data(columns_[score_column]);
+        const float * __restrict__ log_coeff =
+            VectorFloat_data(columns_[log_coeff_column]);
+        const float * __restrict__ precision =
+            VectorFloat_data(columns_[precision_column]);
+        float * __restrict__ temp = VectorFloat_data(*temp_);
+        for (size_t i = 0; i < size; ++i) {
+            temp[i] = 1.f + precision[i] * _mahalanobis(posts_[i], value);
+        }
+        vector_log(size, temp);
+        for (size_t i = 0; i < size; ++i) {
+            scores_accum[i] += score[i] + log_coeff[i] * temp[i];
+        }
     }
+
+    void validate(
+            const Shared &,
+            const std::vector<Group> & groups) const {
+        DIST_ASSERT_EQ(columns_.size(), groups.size());
+        DIST_ASSERT_EQ(posts_.size(), groups.size());
+    }
+
+ private:
+    struct Posterior {
+        Matrix l;
+        Vector mu;
+        float kappa;
+        float nu;
+        uint32_t rank_updates;  // since l was last factored from scratch
+    };
+
+    // bounds the float error that rank updates accumulate in posts_
+    enum { max_rank_updates = 64 };
+
+    static Posterior _posterior(const Shared & full) {
+        Posterior post;
+        DIST_ASSERT(cholesky_factor(full.psi, post.l),
+            "posterior psi is not positive definite");
+        post.mu = full.mu;
+        post.kappa = full.kappa;
+        post.nu = full.nu;
+        post.rank_updates = 0;
+        return post;
+    }
+
+    static float _mahalanobis(const Posterior & post, const Value & value) {
+        const Vector diff = value - post.mu;
+        return cholesky_mahalanobis(post.l, diff);
+    }
+
+    void _update_score(const Shared & shared, size_t groupid) {
+        const Posterior & post = posts_[groupid];
+        const float d = shared.dim();
+        const float dof = post.nu - d + 1.f;
+        const float log_det_sigma = cholesky_log_det(post.l)
+            + d * fast_log((post.kappa + 1.f) / (post.kappa * dof));
+        columns_[score_column][groupid] =
+            mv_student_t_log_normalizer(shared.dim(), dof, log_det_sigma);
+        columns_[log_coeff_column][groupid] = -0.5f * (dof + d);
+        columns_[precision_column][groupid] = post.kappa / (post.kappa + 1.f);
+    }
+
+    enum {
+        score_column,
+        log_coeff_column,
+        precision_column,
+        column_count
+    };
+
+    // per-group scalars; the factored posteriors stay in posts_
+    Columns_<column_count> columns_;
+    Packed_<Posterior, Eigen::aligned_allocator<Posterior>> posts_;
 };
 };  // struct NormalInverseWishart
 
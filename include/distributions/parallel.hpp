@@ -0,0 +1,84 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <distributions/common.hpp>
+
+namespace distributions {
+
+// --------------------------------------------------------------------------
+// Thread Pool
+//
+// This interface runs data-parallel loops on a lazily started,
+// process-wide pool of worker threads.  The calling thread participates
+// in the work and blocks until all chunks are done.  Nested calls from
+// inside a worker, and calls made while the pool is busy, run serially
+// on the calling thread, so it is always safe to call parallel_for.
+
+size_t get_thread_count();
+
+// set_thread_count(1) disables threading,
+// set_thread_count(0) restores the default of one thread per core.
+void set_thread_count(size_t thread_count);
+
+// calls fun(chunk_begin, chunk_end) on disjoint chunks covering [begin, end)
+void parallel_for_chunks(
+        size_t begin,
+        size_t end,
+        size_t min_chunk_size,
+        const std::function<void(size_t, size_t)> & fun);
+
+template<class Fun>
+inline void parallel_for(
+        size_t begin,
+        size_t end,
+        size_t min_chunk_size,
+        const Fun & fun) {
+    if (end <= begin + min_chunk_size or get_thread_count() == 1) {
+        for (size_t i = begin; i < end; ++i) {
+            fun(i);
+        }
+    } else {
+        parallel_for_chunks(begin, end, min_chunk_size,
+            [&fun](size_t chunk_begin, size_t chunk_end) {
+                for (size_t i = chunk_begin; i < chunk_end; ++i) {
+                    fun(i);
+                }
+            });
+    }
+}
+
+// Runs independent tasks, such as loading each feature of a model, on the
+// thread pool.  Any parallel_for inside a task runs serially on its thread.
+inline void parallel_tasks(const std::vector<std::function<void()>> & tasks) {
+    parallel_for(0, tasks.size(), 1, [&tasks](size_t i) { tasks[i](); });
+}
+
+}   // namespace distributions
@@ -32,6 +32,7 @@
 #include <random>
 #include <distributions/common.hpp>
 #include <distributions/special.hpp>
+#include <distributions/vector.hpp>
 #include <distributions/vector_math.hpp>
 #include <distributions/random_fwd.hpp>
 
@@ -39,6 +40,18 @@
 
 namespace distributions {
 
+// Returns the index-th of a family of independent streams, e.g. one per
+// group, so parallel work draws the same numbers for any thread count.
+// Seeds from adjacent integers give correlated rng_t streams, so the seed
+// and index are mixed first.
+inline rng_t rng_stream(uint32_t seed, size_t index) {
+    std::seed_seq seq = {
+        seed,
+        static_cast<uint32_t>(index),
+        static_cast<uint32_t>(static_cast<uint64_t>(index) >> 32)};
+    return rng_t(seq);
+}
+
 inline int sample_int(rng_t & rng, int low, int high) {
     std::uniform_int_distribution<> sampler(low, high);
     return sampler(rng);
@@ -156,32 +169,210 @@ inline float score_student_t(
     return p;
 }
 
-// XXX: not optimized for speed
+// --------------------------------------------------------------------------
+// Cholesky Helpers
+//
+// These work with a lower-triangular factor L of an SPD matrix A = L L^T.
+// Only the lower triangle of L is read, so the packed result of an
+// Eigen::LLT can be passed directly.  2x2 and 3x3 are fully unrolled.
+
+template <typename Matrix>
+inline bool cholesky_factor(const Matrix & a, Matrix & l) {
+    Eigen::LLT<Matrix> llt(a);
+    if (DIST_UNLIKELY(llt.info() != Eigen::Success)) {
+        return false;
+    }
+    l = llt.matrixL();
+    return true;
+}
+
+inline bool cholesky_factor(const Eigen::Matrix2f & a, Eigen::Matrix2f & l) {
+    if (DIST_UNLIKELY(not (a(0, 0) > 0))) {
+        return false;
+    }
+    const float l00 = sqrtf(a(0, 0));
+    const float l10 = a(1, 0) / l00;
+    const float r11 = a(1, 1) - l10 * l10;
+    if (DIST_UNLIKELY(not (r11 > 0))) {
+        return false;
+    }
+    l << l00, 0.f,
+         l10, sqrtf(r11);
+    return true;
+}
+
+inline bool cholesky_factor(const Eigen::Matrix3f & a, Eigen::Matrix3f & l) {
+    if (DIST_UNLIKELY(not (a(0, 0) > 0))) {
+        return false;
+    }
+    const float l00 = sqrtf(a(0, 0));
+    const float l10 = a(1, 0) / l00;
+    const float l20 = a(2, 0) / l00;
+    const float r11 = a(1, 1) - l10 * l10;
+    if (DIST_UNLIKELY(not (r11 > 0))) {
+        return false;
+    }
+    const float l11 = sqrtf(r11);
+    const float l21 = (a(2, 1) - l20 * l10) / l11;
+    const float r22 = a(2, 2) - l20 * l20 - l21 * l21;
+    if (DIST_UNLIKELY(not (r22 > 0))) {
+        return false;
+    }
+    l << l00, 0.f, 0.f,
+         l10, l11, 0.f,
+         l20, l21, sqrtf(r22);
+    return true;
+}
+
+// log(det(L L^T))
+template <typename Matrix>
+inline float cholesky_log_det(const Matrix & l) {
+    float log_det = 0;
+    for (unsigned i = 0, size = l.rows(); i < size; ++i) {
+        log_det += fast_log(l(i, i));
+    }
+    return 2.f * log_det;
+}
+
+inline float cholesky_log_det(const Eigen::Matrix2f & l) {
+    return 2.f * fast_log(l(0, 0) * l(1, 1));
+}
+
+inline float cholesky_log_det(const Eigen::Matrix3f & l) {
+    return 2.f * fast_log(l(0, 0) * l(1, 1) * l(2, 2));
+}
+
+// x^T (L L^T)^{-1} x, by forward substitution
+template <typename Matrix, typename Vector>
+inline float cholesky_mahalanobis(const Matrix & l, const Vector & x) {
+    return l.template triangularView<Eigen::Lower>().solve(x).squaredNorm();
+}
+
+inline float cholesky_mahalanobis(
+        const Eigen::Matrix2f & l,
+        const Eigen::Vector2f & x) {
+    const float y0 = x(0) / l(0, 0);
+    const float y1 = (x(1) - l(1, 0) * y0) / l(1, 1);
+    return y0 * y0 + y1 * y1;
+}
+
+inline float cholesky_mahalanobis(
+        const Eigen::Matrix3f & l,
+        const Eigen::Vector3f & x) {
+    const float y0 = x(0) / l(0, 0);
+    const float y1 = (x(1) - l(1, 0) * y0) / l(1, 1);
+    const float y2 = (x(2) - l(2, 0) * y0 - l(2, 1) * y1) / l(2, 2);
+    return y0 * y0 + y1 * y1 + y2 * y2;
+}
+
+// L L^T += sigma x x^T in place; returns false, leaving l partly updated,
+// if a downdate would cancel away most of a diagonal entry's precision
+template <typename Matrix, typename Vector>
+inline bool cholesky_rank_update(Matrix & l, Vector x, float sigma) {
+    const float min_ratio = 1e-3f;
+    const float sign = sigma > 0 ? 1.f : -1.f;
+    x *= sqrtf(fabsf(sigma));
+    for (unsigned k = 0, size = l.rows(); k < size; ++k) {
+        const float lkk = l(k, k);
+        const float r2 = lkk * lkk + sign * x(k) * x(k);
+        if (DIST_UNLIKELY(not (r2 > min_ratio * lkk * lkk))) {
+            return false;
+        }
+        const float r = sqrtf(r2);
+        const float c = r / lkk;
+        const float s = x(k) / lkk;
+        l(k, k) = r;
+        for (unsigned i = k + 1; i < size; ++i) {
+            l(i, k) = (l(i, k) + sign * s * x(i)) / c;
+            x(i) = c * x(i) - s * l(i, k);
+        }
+    }
+    return true;
+}
+
+// log(det(a)) for SPD a
+template <typename Matrix>
+inline float spd_log_det(const Matrix & a) {
+    Matrix l;
+    DIST_ASSERT(cholesky_factor(a, l), "expected SPD matrix");
+    return cholesky_log_det(l);
+}
+
+// --------------------------------------------------------------------------
+// Multivariate Student-t
+//
+// score(v) = log_normalizer + log_coeff * log(1 + maha(v - mu) / nu)
+
+inline float mv_student_t_log_normalizer(
+        unsigned dim,
+        float nu,
+        float log_det_sigma) {
+    const float d = dim;
+    const float log_pi = 1.1447298858494002;
+    return fast_lgamma(0.5f * (nu + d)) - fast_lgamma(0.5f * nu)
+        - 0.5f * log_det_sigma
+        - 0.5f * d * (fast_log(nu) + log_pi);
+}
+
 template <typename Vector, typename Matrix>
 inline float score_mv_student_t(
         const Vector & v,
         float nu,
         const Vector & mu,
         const Matrix & sigma) {
-  const unsigned d = v.size();
-  const float term1 = fast_lgamma(nu / 2. + static_cast<float>(d) / 2.)
-      - fast_lgamma(nu / 2.);
-
-  // XXX: use Cholesky decomposition to make this faster
-  const Matrix sigma_inv = sigma.inverse();
-  const float sigma_det = sigma.determinant();
-
-  const float log_pi = 1.1447298858494002;
+    Matrix l;
+    DIST_ASSERT(cholesky_factor(sigma, l), "expected SPD matrix");
+    const unsigned d = v.size();
+    const Vector diff = v - mu;
+    return mv_student_t_log_normalizer(d, nu, cholesky_log_det(l))
+        - 0.5f * (nu + static_cast<float>(d))
+        * fast_log(1.f + cholesky_mahalanobis(l, diff) / nu);
+}
 
-  const float term2 = -0.5 * fast_log(sigma_det)
-      - static_cast<float>(d) / 2. * (fast_log(nu) + log_pi);
+// batched version sharing one factorization of sigma
+template <typename Vector, typename Matrix, typename Alloc>
+inline void score_mv_student_t(
+        const std::vector<Vector, Alloc> & values,
+        float nu,
+        const Vector & mu,
+        const Matrix & sigma,
+        AlignedFloats scores_out) {
+    DIST_ASSERT_EQ(values.size(), scores_out.size());
+    Matrix l;
+    DIST_ASSERT(cholesky_factor(sigma, l), "expected SPD matrix");
+    const unsigned d = mu.size();
+    const float log_normalizer =
+        mv_student_t_log_normalizer(d, nu, cholesky_log_det(l));
+    const float log_coeff = -0.5f * (nu + static_cast<float>(d));
+    const float nu_inv = 1.f / nu;
+
+    const size_t size = values.size();
+    float * __restrict__ scores = scores_out.data();
+    for (size_t i = 0; i < size; ++i) {
+        const Vector diff = values[i] - mu;
+        scores[i] = 1.f + nu_inv * cholesky_mahalanobis(l, diff);
+    }
+    vector_log(size, scores);
+    for (size_t i = 0; i < size; ++i) {
+        scores[i] = log_normalizer + log_coeff * scores[i];
+    }
+}
 
-  const Vector diff = v - mu;
+// Assumes factor * factor^T = sigma; factor need not be triangular
+template <typename Vector, typename Matrix>
+inline Vector sample_multivariate_normal_factor(
+        const Vector & mu,
+        const Matrix & factor,
+        rng_t & rng) {
+    DIST_ASSERT_EQ(mu.size(), factor.rows());
 
-  const float term3 = -0.5 * (nu + static_cast<float>(d)) *
-      fast_log(1. + 1. / nu * (diff.dot(sigma_inv * diff)));
+    Vector z(factor.cols());
+    std::normal_distribution<float> norm;
+    for (unsigned i = 0, size = z.size(); i < size; i++) {
+        z(i) = norm(rng);
+    }
 
-  return term1 + term2 + term3;
+    return mu + factor * z;
 }
 
 // Assumes sigma is positive definite
@@ -193,31 +384,18 @@ inline Vector sample_multivariate_normal(
     DIST_ASSERT_EQ(sigma.rows(), sigma.cols());
     DIST_ASSERT_EQ(mu.size(), sigma.rows());
 
-    Eigen::LLT<Matrix> llt(sigma);
-    DIST_ASSERT_EQ(llt.info(), Eigen::Success);
-
-    Vector z(mu.size());
-    std::normal_distribution<float> norm;
-    for (unsigned i = 0; i < mu.size(); i++) {
-        z(i) = norm(rng);
-    }
-
-    return mu + llt.matrixL() * z;
+    Matrix l;
+    DIST_ASSERT(cholesky_factor(sigma, l), "expected SPD matrix");
+    return sample_multivariate_normal_factor(mu, l, rng);
 }
 
-// Based on:
-// http://www.mit.edu/~mattjj/released-code/hsmm/stats_util.py
+// Bartlett decomposition: returns lower-triangular A with
+// A A^T ~ Wishart(nu, I)
 template <typename Matrix>
-inline Matrix sample_wishart(
+inline Matrix sample_bartlett_factor(
+        unsigned size,
         float nu,
-        const Matrix & scale,
         rng_t & rng) {
-    DIST_ASSERT_EQ(scale.rows(), scale.cols());
-
-    Eigen::LLT<Matrix> llt(scale);
-    DIST_ASSERT_EQ(llt.info(), Eigen::Success);
-
-    const unsigned size = scale.rows();
     Matrix A = Matrix::Zero(size, size);
 
     for (unsigned i = 0; i < size; i++) {
@@ -231,19 +409,67 @@ inline Matrix sample_wishart(
         }
     }
 
-    const Matrix X = llt.matrixL() * A;
+    return A;
+}
+
+// Based on:
+// http://www.mit.edu/~mattjj/released-code/hsmm/stats_util.py
+template <typename Matrix>
+inline Matrix sample_wishart(
+        float nu,
+        const Matrix & scale,
+        rng_t & rng) {
+    DIST_ASSERT_EQ(scale.rows(), scale.cols());
+
+    Matrix l;
+    DIST_ASSERT(cholesky_factor(scale, l), "expected SPD matrix");
+    const Matrix A = sample_bartlett_factor<Matrix>(scale.rows(), nu, rng);
+    const Matrix X = l.template triangularView<Eigen::Lower>() * A;
     return X * X.transpose();
 }
 
-// XXX: not optimized for speed
+// Returns X with X X^T ~ InverseWishart(nu, psi).
+// With psi = L L^T and W = L^{-T} A A^T L^{-1} ~ Wishart(nu, psi^{-1}),
+// W^{-1} = X X^T for X = L A^{-T}, so no explicit inverse is needed.
+template <typename Matrix>
+inline Matrix sample_inverse_wishart_factor(
+        float nu,
+        const Matrix & psi,
+        rng_t & rng) {
+    DIST_ASSERT_EQ(psi.rows(), psi.cols());
+
+    Matrix l;
+    DIST_ASSERT(cholesky_factor(psi, l), "expected SPD matrix");
+    const Matrix A = sample_bartlett_factor<Matrix>(psi.rows(), nu, rng);
+    const Matrix Xt = A.template triangularView<Eigen::Lower>().solve(
+        l.transpose());
+    return Xt.transpose();
+}
+
 template <typename Matrix>
 inline Matrix sample_inverse_wishart(
         float nu,
         const Matrix & psi,
         rng_t & rng) {
-    const Matrix psi_inv = psi.inverse();
-    const Matrix sigma_inv = sample_wishart(nu, psi_inv, rng);
-    return sigma_inv.inverse();
+    const Matrix X = sample_inverse_wishart_factor(nu, psi, rng);
+    return X * X.transpose();
+}
+
+// Returns (mu, factor) where factor * factor^T = cov ~ InverseWishart and
+// mu ~ Normal(mu0, cov / lambda)
+template <typename Vector, typename Matrix>
+inline std::pair<Vector, Matrix> sample_normal_inverse_wishart_factor(
+        const Vector & mu0,
+        float lambda,
+        const Matrix & psi,
+        float nu,
+        rng_t & rng) {
+    Matrix factor = sample_inverse_wishart_factor(nu, psi, rng);
+    Vector mu = sample_multivariate_normal_factor(
+        mu0,
+        (factor / sqrtf(lambda)).eval(),
+        rng);
+    return std::make_pair(std::move(mu), std::move(factor));
 }
 
 template <typename Vector, typename Matrix>
@@ -253,9 +479,9 @@ inline std::pair<Vector, Matrix> sample_normal_inverse_wishart(
         const Matrix & psi,
         float nu,
         rng_t & rng) {
-    Matrix cov = 1./lambda * sample_inverse_wishart(nu, psi, rng);
-    Vector mu = sample_multivariate_normal(mu0, cov, rng);
-    return std::make_pair(std::move(mu), std::move(cov));
+    auto p = sample_normal_inverse_wishart_factor(mu0, lambda, psi, nu, rng);
+    Matrix cov = p.second * p.second.transpose();
+    return std::make_pair(std::move(p.first), std::move(cov));
 }
 
 template<class T>
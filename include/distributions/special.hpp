@@ -32,6 +32,7 @@
 #include <cstring>
 #include <iostream>
 #include <limits>
+#include <memory>
 #include <distributions/common.hpp>
 #include <distributions/vendor/fmath.hpp>
 
@@ -214,6 +215,149 @@ inline float fast_log_factorial(const uint32_t & n) {
 }
 
 
+// ---------------------------------------------------------------------------
+// log_rising_factorial
+//
+// log(x (x + 1) ... (x + n - 1)) = lgamma(x + n) - lgamma(x) for x > 0.
+// Short runs take one log of the directly evaluated product; long runs use
+// a difference of Stirling series.  Neither subtracts two lgamma
+// approximations, so small increments do not lose precision.
+
+namespace detail {
+
+enum { log_rising_factorial_max_product = 16 };
+
+// returns m in [0.5, 1) such that prod(x + i) = m * 2^exponent
+inline float rising_factorial_frexp(float x, size_t n, int & exponent) {
+    double prod = 1.0;
+    int e;
+    exponent = 0;
+    for (size_t i = 0; i < n; ++i) {
+        prod *= static_cast<double>(x) + static_cast<double>(i);
+        if ((i & 3) == 3) {
+            prod = frexp(prod, &e);
+            exponent += e;
+        }
+    }
+    prod = frexp(prod, &e);
+    exponent += e;
+    return prod;
+}
+
+float log_rising_factorial_stirling(float x, size_t n);
+
+}  // namespace detail
+
+inline float log_rising_factorial(float x, size_t n) {
+    if (DIST_LIKELY(n < detail::log_rising_factorial_max_product)) {
+        int exponent;
+        const float mantissa = detail::rising_factorial_frexp(x, n, exponent);
+        const float log_2 = 0.69314718055994529f;
+        return fast_log(mantissa) + log_2 * exponent;
+    } else {
+        return detail::log_rising_factorial_stirling(x, n);
+    }
+}
+
+// Extends log_rising_factorial to n < 0, as for DPD groups in data debt.
+// Negative n falls back to a difference of lgammas.
+inline float signed_log_rising_factorial(float x, count_t n) {
+    if (DIST_LIKELY(n >= 0)) {
+        return log_rising_factorial(x, n);
+    } else {
+        return fast_lgamma(x + n) - fast_lgamma(x);
+    }
+}
+
+// out[i] = log_rising_factorial(x[i], n[i]) for normal x[i] > 0.
+// Short products are evaluated across the batch, one element per float
+// lane, with branchless renormalization and one vector_log at the end.
+void vector_log_rising_factorial(
+        const size_t size,
+        const float * __restrict__ x,
+        const size_t * __restrict__ n,
+        float * __restrict__ out);
+
+
+// ---------------------------------------------------------------------------
+// LgammaOffsetCache
+//
+// Tabulates lgamma(offsets[row] + n) for integer n below a bound, where the
+// offsets are hyperparameters such as Shared::alpha.  Published tables are
+// immutable and swapped atomically, so a cache may be read from many
+// threads.  A table is rebuilt whenever the caller's offsets differ from
+// those it was built for, so modifying Shared invalidates it.  Since a
+// table costs one log per entry, a table for new offsets covers at most
+// the lookups of the call that builds it; callers that change Shared on
+// every call, as when scoring hyperparameter grids, then mostly fall back
+// to log_rising_factorial.
+
+class LgammaOffsetCache {
+ public:
+    class Table {
+     public:
+        Table(const float * offsets, size_t row_count, size_t size);
+
+        bool matches(const float * offsets, size_t row_count) const;
+        size_t size() const { return size_; }
+
+        // lgamma(offsets[row] + n) - lgamma(offsets[row])
+        float log_rising_factorial(size_t row, size_t n) const {
+            if (DIST_LIKELY(n < size_)) {
+                return values_[row * size_ + n];
+            } else {
+                return distributions::log_rising_factorial(offsets_[row], n);
+            }
+        }
+
+        // lgamma(offsets[row] + n)
+        float operator()(size_t row, size_t n) const {
+            return lgammas_[row] + log_rising_factorial(row, n);
+        }
+
+     private:
+        const size_t size_;
+        std::vector<float> offsets_;
+        std::vector<float> lgammas_;
+        std::vector<float> values_;
+    };
+
+    typedef std::shared_ptr<const Table> TablePtr;
+
+    enum { default_max_size = 1024 };
+
+    explicit LgammaOffsetCache(size_t max_size = default_max_size) :
+        max_size_(max_size) {}
+
+    LgammaOffsetCache(const LgammaOffsetCache & other) :
+        table_(std::atomic_load(&other.table_)),
+        max_size_(other.max_size_) {}
+
+    LgammaOffsetCache & operator=(const LgammaOffsetCache & other) {
+        std::atomic_store(&table_, std::atomic_load(&other.table_));
+        max_size_ = other.max_size_;
+        return *this;
+    }
+
+    size_t max_size() const { return max_size_; }
+    void set_max_size(size_t max_size) { max_size_ = max_size; }
+
+    // Returns a table for these offsets covering n < min(size, max_size),
+    // or fewer n if the offsets are new and building it would cost more
+    // than lookup_count lookups; other n fall back to log_rising_factorial.
+    // Hold the result across a loop.
+    TablePtr get(
+            const float * offsets,
+            size_t row_count,
+            size_t size,
+            size_t lookup_count) const;
+
+ private:
+    mutable TablePtr table_;
+    size_t max_size_;
+};
+
+
 // ---------------------------------------------------------------------------
 // fast_lgamma_nu
 
@@ -295,6 +439,22 @@ inline float lmultigamma(unsigned d, float a) {
 template<class Alloc>
 void get_log_stirling1_row(size_t n, std::vector<float, Alloc> & result);
 
+// Rows n < log_stirling1_exact_row_count() are computed exactly and cached
+// process-wide; larger rows are approximated.  The default exact range is
+// n < 32 and load_log_stirling1_table may extend it.
+enum { log_stirling1_max_row_count = 1 << 12 };
+size_t log_stirling1_exact_row_count();
+
+// Zero-copy access to the cached row [log(S(n,0)), ..., log(S(n,n))].
+// The returned pointer stays valid for the life of the process; n must be
+// less than log_stirling1_max_row_count.
+const float * log_stirling1_row_view(size_t n);
+
+// Persist exact rows [0, row_count) to a file, and later memory-map such a
+// file to skip building them and to serve those rows exactly.
+void dump_log_stirling1_table(const std::string & filename, size_t row_count);
+void load_log_stirling1_table(const std::string & filename);
+
 inline std::vector<float> log_stirling1_row(size_t n) {
     std::vector<float> result;
     get_log_stirling1_row(n, result);
@@ -27,7 +27,10 @@
 
 #pragma once
 
+#include <algorithm>
 #include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 #include <distributions/aligned_allocator.hpp>
 
@@ -89,4 +92,124 @@ class Aligned_ {
 typedef Packed_<float, aligned_allocator<float>> VectorFloat;
 typedef Aligned_<float> AlignedFloats;
 
+// Value scorer caches are dumped as a list of equal-length columns.  The
+// fingerprint identifies the Shared the columns were computed from;
+// snapshot_load_columns rejects columns computed from any other Shared.
+template<class Writer, class Column>
+void snapshot_dump_columns(
+        Writer & writer,
+        const std::string & prefix,
+        std::vector<float> && fingerprint,
+        const std::vector<const Column *> & columns) {
+    writer.add_vector(prefix + "shared", std::move(fingerprint));
+    for (size_t i = 0; i < columns.size(); ++i) {
+        writer.add_array(
+            prefix + std::to_string(i),
+            columns[i]->data(),
+            columns[i]->size());
+    }
+}
+
+// returns false if the snapshot lacks columns of the expected size
+// computed from a Shared with the given fingerprint
+template<class Reader, class Column>
+bool snapshot_load_columns(
+        const Reader & reader,
+        const std::string & prefix,
+        size_t size,
+        const std::vector<float> & fingerprint,
+        const std::vector<Column *> & columns) {
+    typedef typename Column::value_type Value;
+    if (not reader.has(prefix + "shared")) {
+        return false;
+    }
+    const auto shared = reader.template array<float>(prefix + "shared");
+    if (shared.size != fingerprint.size() or
+            not std::equal(shared.begin(), shared.end(),
+                           fingerprint.begin())) {
+        return false;
+    }
+    for (size_t i = 0; i < columns.size(); ++i) {
+        const std::string name = prefix + std::to_string(i);
+        if (not reader.has(name)) {
+            return false;
+        }
+        if (reader.template array<Value>(name).size != size) {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < columns.size(); ++i) {
+        const auto array =
+            reader.template array<Value>(prefix + std::to_string(i));
+        columns[i]->assign(array.begin(), array.end());
+    }
+    return true;
+}
+
+// A structure of arrays: column_count equal-length columns that are
+// resized, added to and packed-removed from in lockstep.
+template<size_t column_count, class Column = VectorFloat>
+class Columns_ {
+ public:
+    static_assert(column_count > 0, "expected at least one column");
+
+    size_t size() const { return columns_[0].size(); }
+
+    Column & operator[] (size_t column) { return columns_[column]; }
+    const Column & operator[] (size_t column) const {
+        return columns_[column];
+    }
+
+    void resize(size_t size) {
+        for (auto & column : columns_) {
+            column.resize(size);
+        }
+    }
+
+    void packed_add() {
+        for (auto & column : columns_) {
+            column.packed_add();
+        }
+    }
+
+    void packed_remove(size_t pos) {
+        for (auto & column : columns_) {
+            column.packed_remove(pos);
+        }
+    }
+
+    template<class Writer>
+    void snapshot_dump(
+            Writer & writer,
+            const std::string & prefix,
+            std::vector<float> && fingerprint) const {
+        std::vector<const Column *> columns;
+        for (const auto & column : columns_) {
+            columns.push_back(& column);
+        }
+        snapshot_dump_columns(writer, prefix, std::move(fingerprint), columns);
+    }
+
+    template<class Reader>
+    bool snapshot_load(
+            const Reader & reader,
+            const std::string & prefix,
+            size_t size,
+            const std::vector<float> & fingerprint) {
+        std::vector<Column *> columns;
+        for (auto & column : columns_) {
+            columns.push_back(& column);
+        }
+        return snapshot_load_columns(
+            reader,
+            prefix,
+            size,
+            fingerprint,
+            columns);
+    }
+
+ private:
+    Column columns_[column_count];
+};
+
 }  // namespace distributions
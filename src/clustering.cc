@@ -28,6 +28,7 @@
 #include <algorithm>
 #include <distributions/clustering.hpp>
 #include <distributions/special.hpp>
+#include <distributions/parallel.hpp>
 
 namespace distributions {
 
@@ -141,12 +142,118 @@ std::vector<count_t> Clustering<count_t>::PitmanYor::sample_assignments(
     return assignments;
 }
 
-inline float fast_log_ratio(float numer, float denom) {
-    return fast_log(numer / denom);
+namespace {
+
+// A Fenwick tree of nonnegative weights, supporting O(log n) update, append
+// and sampling, for categorical draws whose weights change every draw.
+class WeightTree {
+ public:
+    explicit WeightTree(const std::vector<double> & weights) :
+        tree_(1 + weights.size(), 0.0) {
+        const size_t size = weights.size();
+        for (size_t i = 1; i <= size; ++i) {
+            tree_[i] += weights[i - 1];
+            const size_t parent = i + (i & -i);
+            if (parent <= size) {
+                tree_[parent] += tree_[i];
+            }
+        }
+    }
+
+    size_t size() const { return tree_.size() - 1; }
+
+    void add(size_t pos, double delta) {
+        for (size_t i = pos + 1; i < tree_.size(); i += i & -i) {
+            tree_[i] += delta;
+        }
+    }
+
+    void push_back(double weight) {
+        const size_t i = tree_.size();
+        tree_.push_back(weight + prefix_sum(i - 1) - prefix_sum(i - (i & -i)));
+    }
+
+    // returns the least pos whose inclusive prefix sum exceeds t, or size()
+    size_t find(double t) const {
+        size_t pos = 0;
+        size_t step = 1;
+        while (step * 2 < tree_.size()) {
+            step *= 2;
+        }
+        for (; step; step /= 2) {
+            if (pos + step < tree_.size() and tree_[pos + step] <= t) {
+                pos += step;
+                t -= tree_[pos];
+            }
+        }
+        return pos;
+    }
+
+ private:
+    double prefix_sum(size_t end) const {
+        double sum = 0;
+        for (size_t i = end; i; i -= i & -i) {
+            sum += tree_[i];
+        }
+        return sum;
+    }
+
+    std::vector<double> tree_;
+};
+
+}  // namespace
+
+template<class count_t>
+std::vector<count_t>
+Clustering<count_t>::PitmanYor::sample_posterior_assignments(
+        std::vector<count_t> & counts,
+        count_t size,
+        rng_t & rng) const {
+    // Existing tables have weight count - d, and a new table has weight
+    // alpha + d * table_count, as in score_add_value.
+
+    std::vector<double> weights(counts.size(), 0.0);
+    double total = 0;
+    count_t table_count = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        if (counts[i]) {
+            total += weights[i] = counts[i] - d;
+            table_count += 1;
+        }
+    }
+    WeightTree tree(weights);
+    weights.clear();
+    weights.shrink_to_fit();
+
+    std::vector<count_t> assignments(size);
+    for (count_t & assign : assignments) {
+        const double new_weight = alpha + d * table_count;
+        const double t = sample_unif01(rng) * (total + new_weight);
+        size_t pos = t < total ? tree.find(t) : tree.size();
+        if (DIST_UNLIKELY(pos < tree.size() and counts[pos] == 0)) {
+            pos = tree.size();  // rounding landed on an empty group
+        }
+
+        if (DIST_UNLIKELY(pos == tree.size())) {
+            // new table
+            counts.push_back(1);
+            tree.push_back(1 - d);
+            total += 1 - d;
+            table_count += 1;
+        } else {
+            // existing table
+            counts[pos] += 1;
+            tree.add(pos, 1.0);
+            total += 1;
+        }
+        assign = pos;
+    }
+
+    return assignments;
 }
 
-inline float fast_lgamma_ratio(float start, size_t count) {
-    return fast_lgamma(start + count) - fast_lgamma(start);
+inline float fast_log_ratio(float numer, float denom) {
+    return fast_log(numer / denom);
 }
 
 template<class count_t>
@@ -170,8 +277,8 @@ float Clustering<count_t>::PitmanYor::score_counts(
 
             } else {
                 score += fast_log(alpha + d * nonempty_group_count);
-                score += fast_lgamma_ratio(1 - d, count - 1);
-                score -= fast_lgamma_ratio(alpha + sample_size, count);
+                score += log_rising_factorial(1 - d, count - 1);
+                score -= log_rising_factorial(alpha + sample_size, count);
             }
 
             nonempty_group_count += 1;
@@ -182,6 +289,106 @@ float Clustering<count_t>::PitmanYor::score_counts(
     return score;
 }
 
+// lgamma without the signgam side effect, so it is safe in parallel_for
+inline double lgamma_positive(double x) {
+#if defined(__GLIBC__) || defined(__APPLE__)
+    int sign;
+    return lgamma_r(x, &sign);
+#else
+    return lgamma(x);
+#endif
+}
+
+inline double log_rising_factorial_double(double x, double n) {
+    return lgamma_positive(x + n) - lgamma_positive(x);
+}
+
+// The sequential terms of score_counts telescope into
+//
+//   sum_{k < K} log(alpha + d k)
+//   - log_rising_factorial(alpha, n)
+//   + sum_groups log_rising_factorial(1 - d, size - 1)
+//
+// so only the distinct sizes matter.  The first two terms can be huge,
+// so this works in double precision.
+template<class count_t>
+inline float score_pitman_yor_histogram(
+        float alpha,
+        float d,
+        const std::vector<std::pair<count_t, count_t>> & multiplicities,
+        size_t nonempty_group_count,
+        size_t sample_size) {
+    const double K = nonempty_group_count;
+    double score = 0.0;
+    if (K) {
+        if (d > 0) {
+            score += K * log(d) + log_rising_factorial_double(alpha / d, K);
+        } else {
+            score += K * log(alpha);
+        }
+        score -= log_rising_factorial_double(alpha, sample_size);
+    }
+    const double one_minus_d = 1.0 - d;
+    for (const auto & pair : multiplicities) {
+        if (pair.first > 1) {
+            score += pair.second * log_rising_factorial_double(
+                one_minus_d,
+                pair.first - 1);
+        }
+    }
+    return score;
+}
+
+template<class count_t>
+inline std::vector<std::pair<count_t, count_t>> nonempty_multiplicities(
+        const typename Clustering<count_t>::CountHistogram & histogram) {
+    std::vector<std::pair<count_t, count_t>> result;
+    for (const auto & pair : histogram.multiplicities()) {
+        if (pair.first) {
+            result.push_back(pair);
+        }
+    }
+    return result;
+}
+
+template<class count_t>
+float Clustering<count_t>::PitmanYor::score_histogram(
+        const CountHistogram & histogram) const {
+    const size_t nonempty_group_count =
+        histogram.group_count() - histogram.empty_group_count();
+    return score_pitman_yor_histogram(
+        alpha,
+        d,
+        nonempty_multiplicities<count_t>(histogram),
+        nonempty_group_count,
+        histogram.sample_size());
+}
+
+template<class count_t>
+void Clustering<count_t>::PitmanYor::score_histogram_grid(
+        const CountHistogram & histogram,
+        const std::vector<float> & alphas,
+        const std::vector<float> & ds,
+        std::vector<float> & scores) {
+    const auto multiplicities = nonempty_multiplicities<count_t>(histogram);
+    const size_t nonempty_group_count =
+        histogram.group_count() - histogram.empty_group_count();
+    const size_t sample_size = histogram.sample_size();
+    const size_t d_count = ds.size();
+    scores.resize(alphas.size() * d_count);
+
+    // each cell costs O(#distinct sizes) lgamma calls
+    const size_t min_chunk_size = 1 + 1024 / (1 + multiplicities.size());
+    parallel_for(0, scores.size(), min_chunk_size, [&](size_t i) {
+        scores[i] = score_pitman_yor_histogram(
+            alphas[i / d_count],
+            ds[i % d_count],
+            multiplicities,
+            nonempty_group_count,
+            sample_size);
+    });
+}
+
 // --------------------------------------------------------------------------
 // Low-Entropy Model
 
@@ -247,6 +454,28 @@ float Clustering<count_t>::LowEntropy::score_counts(
     return score;
 }
 
+template<class count_t>
+float Clustering<count_t>::LowEntropy::score_histogram(
+        const CountHistogram & histogram) const {
+    float score = 0.0;
+    for (const auto & pair : histogram.multiplicities()) {
+        const count_t count = pair.first;
+        if (count > 1) {
+            score += pair.second * (count * fast_log(count));
+        }
+    }
+    const count_t sample_size = histogram.sample_size();
+    DIST_ASSERT_LE(sample_size, dataset_size);
+
+    if (sample_size != dataset_size) {
+        float log_factor = _approximate_postpred_correction(sample_size);
+        score += log_factor * (histogram.group_count() - 1);
+        score += _approximate_dataprob_correction(sample_size);
+    }
+    score -= log_partition_function(sample_size);
+    return score;
+}
+
 template<class count_t>
 std::vector<count_t> Clustering<count_t>::LowEntropy::sample_assignments(
         count_t sample_size,
@@ -287,10 +516,8 @@ std::vector<count_t> Clustering<count_t>::LowEntropy::sample_assignments(
 // Explicit template instantiation
 
 template struct Clustering<int32_t>;
-#if 0
 template struct Clustering<int64_t>;
 template struct Clustering<uint32_t>;
 template struct Clustering<uint64_t>;
-#endif
 
 }   // namespace distributions
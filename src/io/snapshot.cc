@@ -0,0 +1,201 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <distributions/io/snapshot.hpp>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+namespace distributions {
+
+static const char snapshot_magic[8] = {'D', 'I', 'S', 'T', 'S', 'N', 'A', 'P'};
+
+inline size_t align_section(size_t offset) {
+    return (offset + section_alignment - 1) / section_alignment
+        * section_alignment;
+}
+
+void SnapshotWriter::_add(
+        const std::string & name,
+        const void * data,
+        size_t size,
+        size_t element_size) {
+    DIST_ASSERT_LT(name.size(), sizeof(SnapshotSection::name));
+    for (const auto & section : sections_) {
+        DIST_ASSERT(section.name != name, "duplicate section: " << name);
+    }
+    Pending section = {name, data, size, element_size};
+    sections_.push_back(section);
+}
+
+size_t SnapshotWriter::write(const std::string & filename) const {
+    SnapshotHeader header;
+    memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+    header.version = snapshot_version;
+    header.section_count = sections_.size();
+
+    std::vector<SnapshotSection> table(sections_.size());
+    size_t offset = align_section(
+        sizeof(SnapshotHeader) + sizeof(SnapshotSection) * table.size());
+    for (size_t i = 0; i < table.size(); ++i) {
+        const Pending & pending = sections_[i];
+        SnapshotSection & section = table[i];
+        memset(section.name, 0, sizeof(section.name));
+        memcpy(section.name, pending.name.data(), pending.name.size());
+        section.offset = offset;
+        section.size = pending.size;
+        section.element_size = pending.element_size;
+        offset = align_section(offset + pending.size * pending.element_size);
+    }
+
+    FILE * file = fopen(filename.c_str(), "wb");
+    DIST_ASSERT(file, "failed to open " << filename);
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (not table.empty()) {
+        ok = ok and fwrite(table.data(), sizeof(SnapshotSection),
+            table.size(), file) == table.size();
+    }
+    const char padding[section_alignment] = {0};
+    size_t position = sizeof(header) + sizeof(SnapshotSection) * table.size();
+    for (size_t i = 0; ok and i < table.size(); ++i) {
+        const size_t pad = table[i].offset - position;
+        const size_t bytes = table[i].size * table[i].element_size;
+        ok = fwrite(padding, 1, pad, file) == pad;
+        ok = ok and fwrite(sections_[i].data, 1, bytes, file) == bytes;
+        position = table[i].offset + bytes;
+    }
+    ok = (fclose(file) == 0) and ok;
+    DIST_ASSERT(ok, "failed to write " << filename);
+    return position;
+}
+
+SnapshotReader::SnapshotReader(const std::string & filename) {
+    const int fid = open(filename.c_str(), O_RDONLY);
+    DIST_ASSERT(fid != -1, "failed to open " << filename);
+    struct stat info;
+    DIST_ASSERT(fstat(fid, &info) == 0, "failed to stat " << filename);
+    size_ = info.st_size;
+    DIST_ASSERT(size_ >= sizeof(SnapshotHeader), "truncated " << filename);
+    void * data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fid, 0);
+    close(fid);
+    DIST_ASSERT(data != MAP_FAILED, "failed to mmap " << filename);
+    data_ = static_cast<const char *>(data);
+
+    const SnapshotHeader & header =
+        * reinterpret_cast<const SnapshotHeader *>(data_);
+    DIST_ASSERT(
+        memcmp(header.magic, snapshot_magic, sizeof(header.magic)) == 0,
+        "not a snapshot: " << filename);
+    DIST_ASSERT_EQ(header.version, snapshot_version);
+    section_count_ = header.section_count;
+    sections_ = reinterpret_cast<const SnapshotSection *>(
+        data_ + sizeof(SnapshotHeader));
+    DIST_ASSERT_LE(
+        sizeof(SnapshotHeader) + sizeof(SnapshotSection) * section_count_,
+        size_);
+    for (size_t i = 0; i < section_count_; ++i) {
+        const SnapshotSection & section = sections_[i];
+        DIST_ASSERT_LE(
+            section.offset + section.size * section.element_size,
+            size_);
+    }
+}
+
+SnapshotReader::~SnapshotReader() {
+    munmap(const_cast<char *>(data_), size_);
+}
+
+const SnapshotSection * SnapshotReader::_find(const std::string & name) const {
+    for (size_t i = 0; i < section_count_; ++i) {
+        const SnapshotSection & section = sections_[i];
+        if (strncmp(section.name, name.c_str(), sizeof(section.name)) == 0) {
+            return & section;
+        }
+    }
+    return nullptr;
+}
+
+inline size_t file_size(const std::string & filename) {
+    struct stat info;
+    return stat(filename.c_str(), &info) == 0 ? info.st_size : 0;
+}
+
+SnapshotLog::SnapshotLog(const std::string & path) :
+    path_(path),
+    delta_count_(0),
+    base_size_(file_size(path)),
+    delta_size_(0) {
+    if (base_size_) {
+        while (size_t size = file_size(filename(delta_count_ + 1))) {
+            delta_size_ += size;
+            ++delta_count_;
+        }
+    }
+}
+
+std::string SnapshotLog::filename(size_t index) const {
+    if (index == 0) {
+        return path_;
+    } else {
+        std::ostringstream filename;
+        filename << path_ << '.' << index;
+        return filename.str();
+    }
+}
+
+size_t SnapshotLog::_write(const SnapshotWriter & writer, size_t index) const {
+    const std::string temp = filename(index) + ".temp";
+    const size_t size = writer.write(temp);
+    if (index == 0) {
+        // drop stale deltas first, so a crash leaves an older but valid log
+        for (size_t i = delta_count_; i; --i) {
+            remove(filename(i).c_str());
+        }
+    }
+    DIST_ASSERT(
+        rename(temp.c_str(), filename(index).c_str()) == 0,
+        "failed to rename " << temp);
+    return size;
+}
+
+void SnapshotLog::write_base(const SnapshotWriter & writer) {
+    base_size_ = _write(writer, 0);
+    delta_count_ = 0;
+    delta_size_ = 0;
+}
+
+void SnapshotLog::write_delta(const SnapshotWriter & writer) {
+    DIST_ASSERT(not empty(), "write_base before write_delta");
+    delta_size_ += _write(writer, delta_count_ + 1);
+    ++delta_count_;
+}
+
+}   // namespace distributions
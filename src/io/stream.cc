@@ -0,0 +1,487 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <distributions/io/stream.hpp>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#ifdef USE_ZLIB
+#  include <zlib.h>
+#endif  // USE_ZLIB
+
+#ifdef USE_BZIP2
+#  include <bzlib.h>
+#endif  // USE_BZIP2
+
+namespace distributions {
+
+enum { stream_block_size = 1 << 20, stream_queue_size = 4 };
+
+inline bool ends_with(const std::string & str, const std::string & suffix) {
+    return str.size() >= suffix.size() and
+        str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// --------------------------------------------------------------------------
+// Sources and Sinks
+
+class StreamSource {
+ public:
+    virtual ~StreamSource() {}
+
+    // returns the number of bytes read, which is zero at end of file
+    virtual size_t read(char * data, size_t size) = 0;
+};
+
+// Sinks report errors rather than asserting, so that they can be closed
+// from destructors.  close() must be called at most once.
+class StreamSink {
+ public:
+    virtual ~StreamSink() {}
+    virtual bool write(const char * data, size_t size) = 0;
+    virtual bool close() = 0;
+};
+
+class FileSource : public StreamSource {
+ public:
+    explicit FileSource(const std::string & filename) :
+        file_(fopen(filename.c_str(), "rb")) {
+        DIST_ASSERT(file_, "failed to open " << filename);
+    }
+
+    ~FileSource() { fclose(file_); }
+
+    size_t read(char * data, size_t size) {
+        size_t result = fread(data, 1, size, file_);
+        DIST_ASSERT(result == size or not ferror(file_), "failed to read");
+        return result;
+    }
+
+ private:
+    FILE * file_;
+};
+
+class FileSink : public StreamSink {
+ public:
+    explicit FileSink(const std::string & filename) :
+        file_(fopen(filename.c_str(), "wb")) {
+        DIST_ASSERT(file_, "failed to open " << filename);
+    }
+
+    ~FileSink() {
+        if (file_) {
+            fclose(file_);
+        }
+    }
+
+    bool write(const char * data, size_t size) {
+        return fwrite(data, 1, size, file_) == size;
+    }
+
+    bool close() {
+        const bool ok = (fclose(file_) == 0);
+        file_ = nullptr;
+        return ok;
+    }
+
+ private:
+    FILE * file_;
+};
+
+#ifdef USE_ZLIB
+
+class GzipSource : public StreamSource {
+ public:
+    explicit GzipSource(const std::string & filename) :
+        file_(gzopen(filename.c_str(), "rb")) {
+        DIST_ASSERT(file_, "failed to open " << filename);
+        gzbuffer(file_, stream_block_size);
+    }
+
+    ~GzipSource() { gzclose(file_); }
+
+    size_t read(char * data, size_t size) {
+        int result = gzread(file_, data, size);
+        DIST_ASSERT(result >= 0, "failed to decompress");
+        return result;
+    }
+
+ private:
+    gzFile file_;
+};
+
+class GzipSink : public StreamSink {
+ public:
+    explicit GzipSink(const std::string & filename) :
+        file_(gzopen(filename.c_str(), "wb")) {
+        DIST_ASSERT(file_, "failed to open " << filename);
+        gzbuffer(file_, stream_block_size);
+    }
+
+    ~GzipSink() {
+        if (file_) {
+            gzclose(file_);
+        }
+    }
+
+    bool write(const char * data, size_t size) {
+        return size == 0 or gzwrite(file_, data, size) == int(size);
+    }
+
+    bool close() {
+        const bool ok = (gzclose(file_) == Z_OK);
+        file_ = nullptr;
+        return ok;
+    }
+
+ private:
+    gzFile file_;
+};
+
+#endif  // USE_ZLIB
+
+#ifdef USE_BZIP2
+
+class Bzip2Source : public StreamSource {
+ public:
+    explicit Bzip2Source(const std::string & filename) :
+        file_(fopen(filename.c_str(), "rb")),
+        done_(false) {
+        DIST_ASSERT(file_, "failed to open " << filename);
+        int error;
+        bz_ = BZ2_bzReadOpen(&error, file_, 0, 0, nullptr, 0);
+        DIST_ASSERT(error == BZ_OK, "failed to open " << filename);
+    }
+
+    ~Bzip2Source() {
+        int error;
+        BZ2_bzReadClose(&error, bz_);
+        fclose(file_);
+    }
+
+    size_t read(char * data, size_t size) {
+        if (done_) {
+            return 0;
+        }
+        int error;
+        int result = BZ2_bzRead(&error, bz_, data, size);
+        if (error == BZ_STREAM_END) {
+            done_ = true;
+        } else {
+            DIST_ASSERT(error == BZ_OK, "failed to decompress");
+        }
+        return result;
+    }
+
+ private:
+    FILE * file_;
+    BZFILE * bz_;
+    bool done_;
+};
+
+class Bzip2Sink : public StreamSink {
+ public:
+    explicit Bzip2Sink(const std::string & filename) :
+        file_(fopen(filename.c_str(), "wb")) {
+        DIST_ASSERT(file_, "failed to open " << filename);
+        int error;
+        bz_ = BZ2_bzWriteOpen(&error, file_, 9, 0, 0);
+        DIST_ASSERT(error == BZ_OK, "failed to open " << filename);
+    }
+
+    ~Bzip2Sink() {
+        if (file_) {
+            close();
+        }
+    }
+
+    bool write(const char * data, size_t size) {
+        int error;
+        BZ2_bzWrite(&error, bz_, const_cast<char *>(data), size);
+        return error == BZ_OK;
+    }
+
+    bool close() {
+        int error;
+        BZ2_bzWriteClose(&error, bz_, 0, nullptr, nullptr);
+        const bool ok = (error == BZ_OK) and (fclose(file_) == 0);
+        file_ = nullptr;
+        return ok;
+    }
+
+ private:
+    FILE * file_;
+    BZFILE * bz_;
+};
+
+#endif  // USE_BZIP2
+
+static StreamSource * open_source(const std::string & filename) {
+    if (ends_with(filename, ".gz")) {
+#ifdef USE_ZLIB
+        return new GzipSource(filename);
+#else  // USE_ZLIB
+        DIST_ERROR("built without zlib, cannot read " << filename);
+#endif  // USE_ZLIB
+    } else if (ends_with(filename, ".bz2")) {
+#ifdef USE_BZIP2
+        return new Bzip2Source(filename);
+#else  // USE_BZIP2
+        DIST_ERROR("built without bzip2, cannot read " << filename);
+#endif  // USE_BZIP2
+    } else {
+        return new FileSource(filename);
+    }
+}
+
+static StreamSink * open_sink(const std::string & filename) {
+    if (ends_with(filename, ".gz")) {
+#ifdef USE_ZLIB
+        return new GzipSink(filename);
+#else  // USE_ZLIB
+        DIST_ERROR("built without zlib, cannot write " << filename);
+#endif  // USE_ZLIB
+    } else if (ends_with(filename, ".bz2")) {
+#ifdef USE_BZIP2
+        return new Bzip2Sink(filename);
+#else  // USE_BZIP2
+        DIST_ERROR("built without bzip2, cannot write " << filename);
+#endif  // USE_BZIP2
+    } else {
+        return new FileSink(filename);
+    }
+}
+
+// --------------------------------------------------------------------------
+// Block Queue
+//
+// This reads a source in large blocks, optionally on a worker thread that
+// stays up to stream_queue_size blocks ahead of the consumer.
+
+class StreamBlockQueue {
+ public:
+    StreamBlockQueue(StreamSource * source, bool background) :
+        source_(source),
+        done_(false),
+        stop_(false) {
+        if (background) {
+            thread_ = std::thread(&StreamBlockQueue::_work, this);
+        }
+    }
+
+    ~StreamBlockQueue() {
+        if (thread_.joinable()) {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            cond_.notify_all();
+            thread_.join();
+        }
+    }
+
+    // replaces block with the next block, or returns false at end of file
+    bool next(std::vector<char> & block) {
+        if (not thread_.joinable()) {
+            return _read_block(block);
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this]{ return not full_.empty() or done_; });
+        if (full_.empty()) {
+            if (error_) {
+                std::rethrow_exception(error_);
+            }
+            return false;
+        }
+        block.swap(full_.front());
+        full_.pop_front();
+        cond_.notify_all();
+        return true;
+    }
+
+ private:
+    bool _read_block(std::vector<char> & block) {
+        block.resize(stream_block_size);
+        size_t size = 0;
+        while (size < block.size()) {
+            size_t count = source_->read(block.data() + size,
+                                         block.size() - size);
+            if (count == 0) {
+                break;
+            }
+            size += count;
+        }
+        block.resize(size);
+        return size;
+    }
+
+    void _work() {
+        try {
+            std::vector<char> block;
+            while (_read_block(block)) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                cond_.wait(lock, [this]{
+                    return full_.size() < stream_queue_size or stop_;
+                });
+                if (stop_) {
+                    return;
+                }
+                full_.push_back(std::vector<char>());
+                full_.back().swap(block);
+                cond_.notify_all();
+            }
+        } catch (...) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            error_ = std::current_exception();
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_ = true;
+        cond_.notify_all();
+    }
+
+    std::unique_ptr<StreamSource> source_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<std::vector<char>> full_;
+    std::exception_ptr error_;
+    bool done_;
+    bool stop_;
+};
+
+// --------------------------------------------------------------------------
+// Reader and Writer
+
+ProtobufStreamReader::ProtobufStreamReader(
+        const std::string & filename,
+        bool background) :
+    blocks_(new StreamBlockQueue(open_source(filename), background)),
+    pos_(0) {
+}
+
+ProtobufStreamReader::~ProtobufStreamReader() {}
+
+size_t ProtobufStreamReader::_read(char * data, size_t size) {
+    size_t total = 0;
+    while (total < size) {
+        if (pos_ == block_.size()) {
+            pos_ = 0;
+            if (not blocks_->next(block_)) {
+                block_.clear();
+                break;
+            }
+        }
+        const size_t count = std::min(size - total, block_.size() - pos_);
+        memcpy(data + total, block_.data() + pos_, count);
+        pos_ += count;
+        total += count;
+    }
+    return total;
+}
+
+bool ProtobufStreamReader::try_read_stream(std::string & record) {
+    unsigned char header[4];
+    const size_t header_size = _read(reinterpret_cast<char *>(header), 4);
+    if (header_size == 0) {
+        return false;
+    }
+    DIST_ASSERT(
+        header_size == 4,
+        "truncated record header of " << header_size << " bytes");
+    const uint32_t size = header[0]
+                        | (header[1] << 8)
+                        | (header[2] << 16)
+                        | (uint32_t(header[3]) << 24);
+    record.resize(size);
+    DIST_ASSERT(
+        size == 0 or _read(&record[0], size) == size,
+        "truncated record of size " << size);
+    return true;
+}
+
+ProtobufStreamWriter::ProtobufStreamWriter(const std::string & filename) :
+    filename_(filename),
+    sink_(open_sink(filename)) {
+    buffer_.reserve(stream_block_size);
+}
+
+ProtobufStreamWriter::~ProtobufStreamWriter() {
+    if (sink_) {
+        const bool flushed = _try_flush();
+        const bool closed = sink_->close();
+        if (not (flushed and closed)) {
+            std::cerr << "WARNING failed to write " << filename_ <<
+                "; call close() to check for errors\n" << std::flush;
+        }
+    }
+}
+
+void ProtobufStreamWriter::write_stream(const char * data, size_t size) {
+    DIST_ASSERT(sink_, "stream is closed: " << filename_);
+    DIST_ASSERT_LE(size, 0xFFFFFFFFUL);
+    const unsigned char header[4] = {
+        static_cast<unsigned char>(size),
+        static_cast<unsigned char>(size >> 8),
+        static_cast<unsigned char>(size >> 16),
+        static_cast<unsigned char>(size >> 24)
+    };
+    if (buffer_.size() + 4 + size > stream_block_size) {
+        flush();
+    }
+    buffer_.insert(buffer_.end(), header, header + 4);
+    buffer_.insert(buffer_.end(), data, data + size);
+}
+
+bool ProtobufStreamWriter::_try_flush() {
+    bool ok = true;
+    if (not buffer_.empty()) {
+        ok = sink_->write(buffer_.data(), buffer_.size());
+        buffer_.clear();
+    }
+    return ok;
+}
+
+void ProtobufStreamWriter::flush() {
+    DIST_ASSERT(sink_, "stream is closed: " << filename_);
+    DIST_ASSERT(_try_flush(), "failed to write " << filename_);
+}
+
+void ProtobufStreamWriter::close() {
+    DIST_ASSERT(sink_, "stream is closed: " << filename_);
+    const bool flushed = _try_flush();
+    const bool closed = sink_->close();
+    sink_.reset();
+    DIST_ASSERT(flushed and closed, "failed to write " << filename_);
+}
+
+}   // namespace distributions
@@ -0,0 +1,154 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <distributions/models/dpd.hpp>
+#include <distributions/io/varint.hpp>
+#include <cmath>
+
+namespace distributions {
+
+template<class Map>
+inline void sort_by_key(
+        const Map & map,
+        std::vector<std::pair<uint32_t, typename Map::value_t>> & pairs) {
+    pairs.clear();
+    pairs.reserve(map.size());
+    for (const auto & pair : map) {
+        pairs.push_back(pair);
+    }
+    std::sort(pairs.begin(), pairs.end());
+}
+
+inline void write_sorted_keys(
+        std::string & out,
+        const std::vector<std::pair<uint32_t, count_t>> & pairs) {
+    varint_write(out, pairs.size());
+    uint32_t prev = 0;
+    for (const auto & pair : pairs) {
+        varint_write(out, pair.first - prev);
+        prev = pair.first;
+    }
+    for (const auto & pair : pairs) {
+        varint_write(out, zigzag_encode(pair.second));
+    }
+}
+
+inline void read_sorted_keys(
+        const char * & pos,
+        const char * end,
+        std::vector<std::pair<uint32_t, count_t>> & pairs) {
+    const size_t size = varint_read(pos, end);
+    DIST_ASSERT_LE(size, size_t(end - pos));
+    pairs.resize(size);
+    uint32_t key = 0;
+    for (auto & pair : pairs) {
+        pair.first = key += varint_read(pos, end);
+    }
+    for (auto & pair : pairs) {
+        pair.second = zigzag_decode(varint_read(pos, end));
+    }
+}
+
+void DirichletProcessDiscrete::Shared::compact_dump(
+        std::string & out,
+        int beta_bytes) const {
+    DIST_ASSERT(2 <= beta_bytes and beta_bytes <= 4, "bad beta_bytes");
+    std::vector<std::pair<uint32_t, count_t>> pairs;
+    pairs.reserve(betas.size());
+    for (const auto & i : betas) {
+        pairs.push_back(std::make_pair(i.first, counts.get_count(i.first)));
+    }
+    std::sort(pairs.begin(), pairs.end());
+
+    out.clear();
+    out.push_back(static_cast<char>(beta_bytes));
+    float_write(out, gamma, 4);
+    float_write(out, alpha, 4);
+    write_sorted_keys(out, pairs);
+    for (const auto & pair : pairs) {
+        float_write(out, betas.get(pair.first), beta_bytes);
+    }
+}
+
+void DirichletProcessDiscrete::Shared::compact_load(const std::string & in) {
+    const char * pos = in.data();
+    const char * end = pos + in.size();
+    DIST_ASSERT(pos != end, "truncated shared");
+    const int beta_bytes = * pos++;
+    DIST_ASSERT(2 <= beta_bytes and beta_bytes <= 4, "bad beta_bytes");
+    gamma = float_read(pos, end, 4);
+    alpha = float_read(pos, end, 4);
+    std::vector<std::pair<uint32_t, count_t>> pairs;
+    read_sorted_keys(pos, end, pairs);
+
+    betas.clear();
+    counts.clear();
+    betas.reserve(pairs.size());
+    counts.reserve(pairs.size());
+    double beta_sum = 0;
+    for (const auto & pair : pairs) {
+        const float beta = float_read(pos, end, beta_bytes);
+        DIST_ASSERT_LT(0, beta);
+        betas.add(pair.first, beta);
+        beta_sum += beta;
+        counts.init_count(pair.first, pair.second);
+    }
+    DIST_ASSERT(pos == end, "trailing bytes in shared");
+
+    // rounded betas can sum past 1 by up to their relative precision
+    const int mantissa_bits = 23 - 8 * (4 - beta_bytes);
+    DIST_ASSERT_LE(beta_sum, 1 + 1e-4 + std::ldexp(1.0, -mantissa_bits));
+    if (beta_bytes < 4 and beta_sum > 1) {
+        for (auto & i : betas) {
+            i.second /= beta_sum;
+        }
+        beta_sum = 1;
+    }
+    beta0 = std::max(0.0, 1.0 - beta_sum);
+}
+
+void DirichletProcessDiscrete::Group::compact_dump(std::string & out) const {
+    std::vector<std::pair<uint32_t, count_t>> pairs;
+    sort_by_key(counts, pairs);
+    out.clear();
+    write_sorted_keys(out, pairs);
+}
+
+void DirichletProcessDiscrete::Group::compact_load(const std::string & in) {
+    const char * pos = in.data();
+    const char * end = pos + in.size();
+    std::vector<std::pair<uint32_t, count_t>> pairs;
+    read_sorted_keys(pos, end, pairs);
+    DIST_ASSERT(pos == end, "trailing bytes in group");
+    counts.clear();
+    counts.reserve(pairs.size());
+    for (const auto & pair : pairs) {
+        counts.init_count(pair.first, pair.second);
+    }
+}
+
+}   // namespace distributions
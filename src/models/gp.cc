@@ -29,6 +29,41 @@
 #include <distributions/vector_math.hpp>
 
 namespace distributions {
+
+// This is Scorer::init applied column-wise, batching the logs.
+void GammaPoisson::MixtureValueScorer::update_all(
+        const Shared & shared,
+        const std::vector<Group> & groups,
+        rng_t &) {
+    columns_.resize(groups.size());
+
+    // each chunk of groups fills a disjoint slice of every column
+    parallel_for_chunks(0, groups.size(), min_parallel_work,
+        [this, &shared, &groups](size_t begin, size_t end) {
+            const size_t size = end - begin;
+            float * __restrict__ score =
+                VectorFloat_data(columns_[score_column]) + begin;
+            float * __restrict__ post_alpha =
+                VectorFloat_data(columns_[post_alpha_column]) + begin;
+            float * __restrict__ score_coeff =
+                VectorFloat_data(columns_[score_coeff_column]) + begin;
+
+            for (size_t i = 0; i < size; ++i) {
+                const Group & group = groups[begin + i];
+                const float post_inv_beta = shared.inv_beta + group.count;
+                post_alpha[i] = shared.alpha + group.sum;
+                score[i] = post_inv_beta;
+                score_coeff[i] = 1.f + post_inv_beta;
+            }
+            vector_log(size, score);
+            vector_log(size, score_coeff);
+            for (size_t i = 0; i < size; ++i) {
+                score_coeff[i] = -score_coeff[i];
+                score[i] = -fast_lgamma(post_alpha[i])
+                         + post_alpha[i] * (score[i] + score_coeff[i]);
+            }
+        });
+}
 void GammaPoisson::MixtureValueScorer::score_value(
         const Shared &,
         const std::vector<Group> &,
@@ -47,11 +82,12 @@ void GammaPoisson::MixtureValueScorer::score_value(
     const float value_noalias = value;
     float * __restrict__ scores_accum_noalias =
         VectorFloat_data(scores_accum);
-    const float * __restrict__ score = VectorFloat_data(score_);
+    const float * __restrict__ score =
+        VectorFloat_data(columns_[score_column]);
     const float * __restrict__ post_alpha =
-        VectorFloat_data(post_alpha_);
+        VectorFloat_data(columns_[post_alpha_column]);
     const float * __restrict__ score_coeff =
-        VectorFloat_data(score_coeff_);
+        VectorFloat_data(columns_[score_coeff_column]);
     float * __restrict__ temp = VectorFloat_data(*temp_);
 
     const float log_factorial_value = fast_log_factorial(value);
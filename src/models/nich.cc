@@ -30,6 +30,43 @@
 
 namespace distributions {
 
+// This is Scorer::init applied column-wise, batching the logs.
+void NormalInverseChiSq::MixtureValueScorer::update_all(
+        const Shared & shared,
+        const std::vector<Group> & groups,
+        rng_t &) {
+    columns_.resize(groups.size());
+
+    // each chunk of groups fills a disjoint slice of every column
+    parallel_for_chunks(0, groups.size(), min_parallel_work,
+        [this, &shared, &groups](size_t begin, size_t end) {
+            const size_t size = end - begin;
+            float * __restrict__ score =
+                VectorFloat_data(columns_[score_column]) + begin;
+            float * __restrict__ log_coeff =
+                VectorFloat_data(columns_[log_coeff_column]) + begin;
+            float * __restrict__ precision =
+                VectorFloat_data(columns_[precision_column]) + begin;
+            float * __restrict__ mean =
+                VectorFloat_data(columns_[mean_column]) + begin;
+
+            for (size_t i = 0; i < size; ++i) {
+                Shared post = shared.plus_group(groups[begin + i]);
+                float lambda =
+                    post.kappa / ((post.kappa + 1.f) * post.sigmasq);
+                score[i] = lambda / (M_PIf * post.nu);
+                log_coeff[i] = -0.5f * post.nu - 0.5f;
+                precision[i] = lambda / post.nu;
+                mean[i] = post.mu;
+            }
+            vector_log(size, score);
+            for (size_t i = 0; i < size; ++i) {
+                const float post_nu = shared.nu + groups[begin + i].count;
+                score[i] = fast_lgamma_nu(post_nu) + 0.5f * score[i];
+            }
+        });
+}
+
 void NormalInverseChiSq::MixtureValueScorer::score_value(
         const Shared &,
         const std::vector<Group> &,
@@ -48,12 +85,13 @@ void NormalInverseChiSq::MixtureValueScorer::score_value(
     const float value_noalias = value;
     float * __restrict__ scores_accum_noalias = VectorFloat_data(scores_accum);
     const float * __restrict__ score =
-        VectorFloat_data(score_);
+        VectorFloat_data(columns_[score_column]);
     const float * __restrict__ log_coeff =
-        VectorFloat_data(log_coeff_);
+        VectorFloat_data(columns_[log_coeff_column]);
     const float * __restrict__ precision =
-        VectorFloat_data(precision_);
-    const float * __restrict__ mean = VectorFloat_data(mean_);
+        VectorFloat_data(columns_[precision_column]);
+    const float * __restrict__ mean =
+        VectorFloat_data(columns_[mean_column]);
     float * __restrict__ temp = VectorFloat_data(*temp_);
 
     // Version 1
@@ -0,0 +1,267 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <distributions/parallel.hpp>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace distributions {
+namespace {
+
+static thread_local bool in_worker = false;
+
+class ThreadPool {
+ public:
+    ThreadPool() :
+        thread_count_(0),
+        pid_(0),
+        stopping_(false),
+        generation_(0),
+        active_(0) {}
+
+    ~ThreadPool() { _stop(); }
+
+    size_t thread_count() const {
+        if (size_t count = thread_count_) {
+            return count;
+        }
+        size_t count = std::thread::hardware_concurrency();
+        return count ? count : 1;
+    }
+
+    void set_thread_count(size_t thread_count) {
+        std::lock_guard<std::mutex> busy(busy_mutex_);
+        _stop();
+        thread_count_ = thread_count;
+    }
+
+    void run(
+            size_t begin,
+            size_t end,
+            size_t min_chunk_size,
+            const std::function<void(size_t, size_t)> & fun) {
+        std::unique_lock<std::mutex> busy(busy_mutex_, std::try_to_lock);
+        const size_t thread_count = this->thread_count();
+        if (in_worker or not busy.owns_lock() or thread_count == 1) {
+            fun(begin, end);
+            return;
+        }
+        _start(thread_count);
+
+        const size_t size = end - begin;
+        size_t chunk_count = size / (min_chunk_size ? min_chunk_size : 1);
+        chunk_count = std::max<size_t>(1, chunk_count);
+        chunk_count = std::min<size_t>(4 * thread_count, chunk_count);
+
+        {
+            // a worker that woke late for the previous task may still be
+            // reading it, so wait for it before publishing this one
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_cv_.wait(lock, [this] { return active_ == 0; });
+            task_.fun = & fun;
+            task_.begin = begin;
+            task_.size = size;
+            task_.chunk_count = chunk_count;
+            task_.next_chunk = 0;
+            task_.completed = 0;
+            task_.error = nullptr;
+            ++generation_;
+        }
+        work_cv_.notify_all();
+
+        in_worker = true;
+        _work(_task_params(), generation_);
+        in_worker = false;
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [this, chunk_count] {
+            return task_.completed == chunk_count and active_ == 0;
+        });
+        task_.fun = nullptr;
+        if (task_.error) {
+            std::rethrow_exception(task_.error);
+        }
+    }
+
+ private:
+    struct TaskParams {
+        const std::function<void(size_t, size_t)> * fun;
+        size_t begin;
+        size_t size;
+        size_t chunk_count;
+    };
+
+    struct Task {
+        const std::function<void(size_t, size_t)> * fun;
+        size_t begin;
+        size_t size;
+        size_t chunk_count;
+        std::atomic<size_t> next_chunk;
+        std::atomic<size_t> completed;
+        std::exception_ptr error;
+    };
+
+    void _start(size_t thread_count) {
+        const pid_t pid = getpid();
+        if (DIST_UNLIKELY(pid != pid_)) {
+            // worker threads do not survive fork()
+            for (auto & worker : workers_) {
+                worker.detach();
+            }
+            workers_.clear();
+            pid_ = pid;
+        }
+        while (workers_.size() + 1 < thread_count) {
+            workers_.push_back(std::thread(&ThreadPool::_worker_loop, this));
+        }
+    }
+
+    void _stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        work_cv_.notify_all();
+        if (getpid() == pid_) {
+            for (auto & worker : workers_) {
+                worker.join();
+            }
+        } else {
+            for (auto & worker : workers_) {
+                worker.detach();
+            }
+        }
+        workers_.clear();
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = false;
+    }
+
+    void _worker_loop() {
+        in_worker = true;
+        size_t seen = 0;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            work_cv_.wait(lock, [this, &seen] {
+                return stopping_ or generation_ != seen;
+            });
+            if (stopping_) {
+                return;
+            }
+            seen = generation_;
+            ++active_;
+            const TaskParams params = _task_params();
+            lock.unlock();
+            _work(params, seen);
+            lock.lock();
+            if (--active_ == 0) {
+                done_cv_.notify_all();
+            }
+        }
+    }
+
+    // must be called with mutex_ held, or by the thread that published task_
+    TaskParams _task_params() const {
+        TaskParams params;
+        params.fun = task_.fun;
+        params.begin = task_.begin;
+        params.size = task_.size;
+        params.chunk_count = task_.chunk_count;
+        return params;
+    }
+
+    void _work(const TaskParams & params, size_t generation) {
+        const size_t chunk_count = params.chunk_count;
+        while (generation_ == generation) {
+            const size_t chunk = task_.next_chunk++;
+            if (chunk >= chunk_count) {
+                return;
+            }
+            const size_t chunk_begin =
+                params.begin + params.size * chunk / chunk_count;
+            const size_t chunk_end =
+                params.begin + params.size * (chunk + 1) / chunk_count;
+            try {
+                (*params.fun)(chunk_begin, chunk_end);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (not task_.error) {
+                    task_.error = std::current_exception();
+                }
+            }
+            if (++task_.completed == chunk_count) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                done_cv_.notify_all();
+            }
+        }
+    }
+
+    std::atomic<size_t> thread_count_;
+    pid_t pid_;
+    std::vector<std::thread> workers_;
+    std::mutex busy_mutex_;
+    std::mutex mutex_;
+    std::condition_variable work_cv_;
+    std::condition_variable done_cv_;
+    bool stopping_;
+    std::atomic<size_t> generation_;
+    size_t active_;
+    Task task_;
+};
+
+static ThreadPool thread_pool;
+
+}   // anonymous namespace
+
+size_t get_thread_count() {
+    return thread_pool.thread_count();
+}
+
+void set_thread_count(size_t thread_count) {
+    thread_pool.set_thread_count(thread_count);
+}
+
+void parallel_for_chunks(
+        size_t begin,
+        size_t end,
+        size_t min_chunk_size,
+        const std::function<void(size_t, size_t)> & fun) {
+    if (end <= begin + min_chunk_size) {
+        if (begin < end) {
+            fun(begin, end);
+        }
+    } else {
+        thread_pool.run(begin, end, min_chunk_size, fun);
+    }
+}
+
+}   // namespace distributions
@@ -27,6 +27,15 @@
 
 #include <distributions/special.hpp>
 #include <distributions/vector.hpp>
+#include <distributions/vector_math.hpp>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
 #include <mutex>
 
 namespace distributions {
@@ -52,35 +61,45 @@ const char LogTable256[256] = {
 };
 
 
-static std::mutex log_stirling1_mutex;
-static std::vector<VectorFloat> log_stirling1_cache;
+// Each row is published exactly once through an atomic pointer and is never
+// freed or modified, so readers do not lock.  Rows either live on the heap
+// (built lazily, in order) or in a file mapped by load_log_stirling1_table.
+static std::atomic<const float *>
+    log_stirling1_rows[log_stirling1_max_row_count];
+static std::atomic<size_t> log_stirling1_exact_rows(32);
+static std::mutex log_stirling1_build_mutex;  // serializes builders only
 
-inline void log_stirling1_cache_add() {
-    size_t n = log_stirling1_cache.size();
-    log_stirling1_cache.push_back(VectorFloat());
-    VectorFloat & row = log_stirling1_cache.back();
-    row.resize(n + 1);
-    row[0] = -INFINITY;
-    row[n] = 0;
-    if (n > 1) {
-        const VectorFloat & prev = log_stirling1_cache[n - 1];
-        const float log_n_minus_1 = logf(n - 1);
-        for (size_t k = 1; k < n; ++k) {
-            row[k] = log_sum_exp(log_n_minus_1 + prev[k], prev[k - 1]);
+static const char log_stirling1_magic[8] = "STIRLG1";
+
+inline const float * log_stirling1_build_rows(const size_t n) {
+    std::unique_lock<std::mutex> lock(log_stirling1_build_mutex);
+
+    size_t begin = n;
+    while (begin and not log_stirling1_rows[begin].load()) {
+        --begin;
+    }
+    for (size_t i = begin; i <= n; ++i) {
+        if (log_stirling1_rows[i].load()) {
+            continue;
+        }
+        float * row = new float[i + 1];  // never freed
+        row[0] = -INFINITY;
+        row[i] = 0;
+        if (i > 1) {
+            const float * prev = log_stirling1_rows[i - 1].load();
+            const float log_i_minus_1 = logf(i - 1);
+            for (size_t k = 1; k < i; ++k) {
+                row[k] = log_sum_exp(log_i_minus_1 + prev[k], prev[k - 1]);
+            }
         }
+        log_stirling1_rows[i].store(row, std::memory_order_release);
     }
+    return log_stirling1_rows[n].load();
 }
 
 inline void get_log_stirling1_row_exact(const size_t n, float * row) {
-    // this could really be a readers-writer shared_mutex
-    std::unique_lock<std::mutex> lock(log_stirling1_mutex);
-
-    while (n >= log_stirling1_cache.size()) {
-        log_stirling1_cache_add();
-    }
-
-    auto const & cached = log_stirling1_cache[n];
-    memcpy(row, cached.data(), cached.size() * sizeof(row[0]));
+    const float * cached = log_stirling1_row_view(n);
+    memcpy(row, cached, (n + 1) * sizeof(row[0]));
 }
 
 inline void get_log_stirling1_row_approx(const size_t n, float * row) {
@@ -134,7 +153,7 @@ inline void get_log_stirling1_row_approx(const size_t n, float * row) {
 }
 
 void get_log_stirling1_row(size_t n, float * result) {
-    if (n < 32) {
+    if (n < log_stirling1_exact_rows.load(std::memory_order_acquire)) {
         get_log_stirling1_row_exact(n, result);
     } else {
         get_log_stirling1_row_approx(n, result);
@@ -276,6 +295,249 @@ void get_log_stirling1_row(size_t n, std::vector<float, Alloc> & result) {
     detail::get_log_stirling1_row(n, result.data());
 }
 
+size_t log_stirling1_exact_row_count() {
+    return detail::log_stirling1_exact_rows.load(std::memory_order_acquire);
+}
+
+const float * log_stirling1_row_view(size_t n) {
+    DIST_ASSERT(n < log_stirling1_max_row_count, "row out of range: " << n);
+    const float * row =
+        detail::log_stirling1_rows[n].load(std::memory_order_acquire);
+    if (DIST_UNLIKELY(not row)) {
+        row = detail::log_stirling1_build_rows(n);
+    }
+    return row;
+}
+
+// file layout: magic, uint64 row_count, then rows 0, 1, ... back to back
+void dump_log_stirling1_table(const std::string & filename, size_t row_count) {
+    DIST_ASSERT_LE(row_count, log_stirling1_max_row_count);
+    FILE * file = fopen(filename.c_str(), "wb");
+    DIST_ASSERT(file, "failed to open " << filename);
+    const uint64_t header_row_count = row_count;
+    bool ok = fwrite(detail::log_stirling1_magic, 8, 1, file) == 1;
+    ok = ok and fwrite(&header_row_count, 8, 1, file) == 1;
+    for (size_t n = 0; ok and n < row_count; ++n) {
+        ok = fwrite(log_stirling1_row_view(n), sizeof(float), n + 1, file)
+            == n + 1;
+    }
+    ok = (fclose(file) == 0) and ok;
+    DIST_ASSERT(ok, "failed to write " << filename);
+}
+
+void load_log_stirling1_table(const std::string & filename) {
+    const int fid = open(filename.c_str(), O_RDONLY);
+    DIST_ASSERT(fid != -1, "failed to open " << filename);
+    struct stat info;
+    DIST_ASSERT(fstat(fid, &info) == 0, "failed to stat " << filename);
+    const size_t size = info.st_size;
+    const size_t header_size = 16;
+    DIST_ASSERT(size >= header_size, "truncated file " << filename);
+    void * data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fid, 0);
+    close(fid);
+    DIST_ASSERT(data != MAP_FAILED, "failed to mmap " << filename);
+
+    // the mapping is never released, since rows may be handed out as views
+    const char * bytes = static_cast<const char *>(data);
+    DIST_ASSERT(memcmp(bytes, detail::log_stirling1_magic, 8) == 0,
+        "bad magic in " << filename);
+    uint64_t row_count;
+    memcpy(&row_count, bytes + 8, 8);
+    DIST_ASSERT_LE(row_count, log_stirling1_max_row_count);
+    DIST_ASSERT_EQ(size,
+        header_size + sizeof(float) * row_count * (row_count + 1) / 2);
+
+    const float * rows = reinterpret_cast<const float *>(bytes + header_size);
+    for (size_t n = 0; n < row_count; ++n) {
+        const float * expected = nullptr;
+        detail::log_stirling1_rows[n].compare_exchange_strong(
+            expected,
+            rows + n * (n + 1) / 2,
+            std::memory_order_release);
+    }
+
+    size_t exact = detail::log_stirling1_exact_rows.load();
+    while (exact < row_count and
+           not detail::log_stirling1_exact_rows.compare_exchange_weak(
+               exact,
+               row_count,
+               std::memory_order_release)) {}
+}
+
+namespace detail {
+
+float log_rising_factorial_stirling(float x, size_t n) {
+    // shift x up with a short product so the series converges quickly
+    double y = x;
+    double prod = 1.0;
+    while (y < 8.0 and n) {
+        prod *= y;
+        y += 1.0;
+        --n;
+    }
+    double result = log(prod);
+    if (n) {
+        const double m = n;
+        const double z = y + m;
+        const double y_inv = 1.0 / y;
+        const double z_inv = 1.0 / z;
+        result += (y - 0.5) * log1p(m / y) + m * log(z) - m
+                + (z_inv - y_inv) / 12.0
+                - (z_inv * z_inv * z_inv - y_inv * y_inv * y_inv) / 360.0;
+    }
+    return result;
+}
+
+}  // namespace detail
+
+namespace {
+
+// elements per block of vector_log_rising_factorial's stack scratch
+enum { rising_factorial_block_size = 256 };
+
+// io[i] = m[i] * 2^exponent[i] for m[i] in [0.5, 1); accumulates exponent.
+// Operates on the bits of positive normal floats, so it vectorizes,
+// unlike frexp.
+inline void vector_renormalize(
+        const size_t size,
+        float * __restrict__ io,
+        int32_t * __restrict__ exponent) {
+    const uint32_t exponent_mask = 0x7f800000U;
+    const uint32_t half = 0x3f000000U;
+    for (size_t i = 0; i < size; ++i) {
+        uint32_t bits;
+        memcpy(& bits, io + i, sizeof(bits));
+        exponent[i] += static_cast<int32_t>(bits >> 23) - 126;
+        bits = (bits & ~exponent_mask) | half;
+        memcpy(io + i, & bits, sizeof(bits));
+    }
+}
+
+}  // namespace
+
+void vector_log_rising_factorial(
+        const size_t size,
+        const float * __restrict__ x,
+        const size_t * __restrict__ n,
+        float * __restrict__ out) {
+    const size_t max_product = detail::log_rising_factorial_max_product;
+    const size_t block_size = rising_factorial_block_size;
+    const float log_2 = 0.69314718055994529f;
+    alignas(default_alignment) float ns[block_size];
+    alignas(default_alignment) int32_t exponents[block_size];
+    alignas(default_alignment) float shifts[block_size];
+
+    for (size_t begin = 0; begin < size; begin += block_size) {
+        const size_t count = std::min(block_size, size - begin);
+        const float * __restrict__ xs = x + begin;
+        float * __restrict__ prods = out + begin;
+
+        // short products run in float lanes, one element per lane; the
+        // rest get an empty product plus a scalar Stirling difference
+        size_t max_n = 0;
+        float max_x = 0;
+        for (size_t i = 0; i < count; ++i) {
+            const size_t n_i = n[begin + i];
+            if (DIST_LIKELY(n_i < max_product)) {
+                ns[i] = n_i;
+                shifts[i] = 0;
+                max_n = std::max(max_n, n_i);
+                max_x = std::max(max_x, xs[i]);
+            } else {
+                ns[i] = 0;
+                shifts[i] = detail::log_rising_factorial_stirling(xs[i], n_i);
+            }
+            prods[i] = 1.f;
+            exponents[i] = 0;
+        }
+
+        // Each step multiplies every lane by its next factor, or by 1 once
+        // its product is complete, so a block costs max_n steps.  Products
+        // are renormalized to [0.5, 1) before they could overflow, after
+        // every second factor while factors stay below 1e18 < 2^60 and
+        // otherwise after every factor.
+        const size_t period = (max_x + max_product < 1e18f) ? 2 : 1;
+        for (size_t k = 0; k < max_n; ++k) {
+            const float offset = k;
+            for (size_t i = 0; i < count; ++i) {
+                const float factor = xs[i] + offset;
+                prods[i] *= (offset < ns[i]) ? factor : 1.f;
+            }
+            if ((k + 1) % period == 0) {
+                vector_renormalize(count, prods, exponents);
+            }
+        }
+        vector_renormalize(count, prods, exponents);
+
+        for (size_t i = 0; i < count; ++i) {
+            shifts[i] += log_2 * exponents[i];
+        }
+        vector_log(count, prods);
+        for (size_t i = 0; i < count; ++i) {
+            prods[i] += shifts[i];
+        }
+    }
+}
+
+LgammaOffsetCache::Table::Table(
+        const float * offsets,
+        size_t row_count,
+        size_t size) :
+    size_(size),
+    offsets_(offsets, offsets + row_count),
+    lgammas_(row_count),
+    values_(row_count * size) {
+    for (size_t row = 0; row < row_count; ++row) {
+        const double offset = offsets[row];
+        lgammas_[row] = fast_lgamma(offsets[row]);
+        float * __restrict__ values = values_.data() + row * size;
+        double sum = 0;
+        for (size_t n = 0; n < size; ++n) {
+            values[n] = sum;
+            sum += log(offset + n);
+        }
+    }
+}
+
+bool LgammaOffsetCache::Table::matches(
+        const float * offsets,
+        size_t row_count) const {
+    if (row_count != offsets_.size()) {
+        return false;
+    }
+    for (size_t row = 0; row < row_count; ++row) {
+        if (offsets[row] != offsets_[row]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+LgammaOffsetCache::TablePtr LgammaOffsetCache::get(
+        const float * offsets,
+        size_t row_count,
+        size_t size,
+        size_t lookup_count) const {
+    size = std::min(size, max_size_);
+    TablePtr table = std::atomic_load(&table_);
+    if (table and table->matches(offsets, row_count)) {
+        if (DIST_LIKELY(table->size() >= size)) {
+            return table;
+        }
+        // grow geometrically so a slowly rising count rebuilds rarely
+        size = std::min(max_size_, std::max(size, 2 * table->size()));
+    } else {
+        // Each entry costs a log, so tables for new offsets only cover what
+        // this call's lookups repay.  Offsets seen twice get a full table.
+        size = std::min(size, lookup_count / row_count);
+    }
+    auto built = std::make_shared<const Table>(offsets, row_count, size);
+    if (size) {
+        std::atomic_store(&table_, built);
+    }
+    return built;
+}
+
 // --------------------------------------------------------------------------
 // Explicit template instantiations
 
@@ -0,0 +1,216 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <math.h>
+#include <vector>
+#include <distributions/clustering.hpp>
+#include <distributions/mixture.hpp>
+#include <distributions/random.hpp>
+
+using namespace distributions;  // NOLINT(*)
+
+typedef Clustering<int>::CountHistogram CountHistogram;
+typedef Clustering<int>::PitmanYor PitmanYor;
+typedef Clustering<int>::LowEntropy LowEntropy;
+
+inline void assert_close(float actual, float expected) {
+    DIST_ASSERT(fabs(actual - expected) <= 1e-4f * (1 + fabs(expected)),
+        "actual = " << actual << ", expected = " << expected);
+}
+
+void test_count_histogram() {
+    CountHistogram histogram({0, 3, 1, 3, 0, 3});
+    DIST_ASSERT_EQ(histogram.group_count(), 6);
+    DIST_ASSERT_EQ(histogram.sample_size(), 10);
+    DIST_ASSERT_EQ(histogram.empty_group_count(), 2);
+    DIST_ASSERT_EQ(histogram.multiplicities().size(), 3);
+    DIST_ASSERT_EQ(histogram.multiplicity(1), 1);
+    DIST_ASSERT_EQ(histogram.multiplicity(2), 0);
+    DIST_ASSERT_EQ(histogram.multiplicity(3), 3);
+
+    histogram.resize_group(3, 7);
+    histogram.resize_group(3, 2);
+    histogram.resize_group(3, 2);
+    DIST_ASSERT_EQ(histogram.multiplicities().size(), 4);
+    DIST_ASSERT_EQ(histogram.sample_size(), 12);
+
+    histogram.resize_group(7, 0);
+    histogram.remove_group();
+    DIST_ASSERT_EQ(histogram.multiplicities().size(), 3);
+    DIST_ASSERT_EQ(histogram.group_count(), 5);
+    DIST_ASSERT_EQ(histogram.empty_group_count(), 2);
+
+    // only distinct sizes are stored, however large
+    histogram.resize_group(2, 1000000000);
+    DIST_ASSERT_EQ(histogram.multiplicities().size(), 4);
+    DIST_ASSERT_EQ(histogram.multiplicity(1000000000), 1);
+    histogram.resize_group(1000000000, 2);
+    DIST_ASSERT_EQ(histogram.multiplicities().size(), 3);
+}
+
+template<class Model>
+void test_score_histogram(const Model & model, rng_t & rng) {
+    for (int size : {1, 2, 10, 100, 1000}) {
+        std::vector<int> counts;
+        for (int groupid : model.sample_assignments(size, rng)) {
+            if (counts.size() <= static_cast<size_t>(groupid)) {
+                counts.resize(groupid + 1, 0);
+            }
+            counts[groupid] += 1;
+        }
+        counts.push_back(0);
+        const CountHistogram histogram(counts);
+        assert_close(
+            model.score_histogram(histogram),
+            model.score_counts(counts));
+    }
+}
+
+// the cached mixture must agree with the uncached MixtureDriver fallback
+template<class Model>
+void test_cached_mixture(const Model & model, rng_t & rng) {
+    typename Model::CachedMixture mixture;
+    MixtureDriver<Model, int> driver;
+    mixture.counts().push_back(0);
+    driver.counts().push_back(0);
+    mixture.init(model);
+    driver.init(model);
+    std::vector<size_t> assignments;
+    VectorFloat actual;
+    VectorFloat expected;
+    for (size_t i = 0; i < 1000; ++i) {
+        const bool add = assignments.size() < 50 or
+            (assignments.size() < 200 and sample_bernoulli(rng, 0.5f));
+        if (add) {
+            const size_t groupid =
+                sample_int(rng, 0, mixture.counts().size() - 1);
+            mixture.add_value(model, groupid);
+            driver.add_value(model, groupid);
+            assignments.push_back(groupid);
+        } else {
+            const size_t pos = sample_int(rng, 0, assignments.size() - 1);
+            const size_t groupid = assignments[pos];
+            assignments[pos] = assignments.back();
+            assignments.pop_back();
+            const size_t moved = mixture.counts().size() - 1;
+            const bool removed = mixture.remove_value(model, groupid);
+            DIST_ASSERT_EQ(driver.remove_value(model, groupid), removed);
+            if (removed) {
+                for (auto & other : assignments) {
+                    if (other == moved) {
+                        other = groupid;
+                    }
+                }
+            }
+        }
+        DIST_ASSERT(mixture.counts() == driver.counts(),
+            "counts out of sync after step " << i);
+        const CountHistogram histogram(mixture.counts());
+        DIST_ASSERT(
+            mixture.histogram().multiplicities() == histogram.multiplicities(),
+            "histogram out of sync after step " << i);
+        DIST_ASSERT_EQ(mixture.histogram().sample_size(), assignments.size());
+        assert_close(
+            mixture.score_data(model),
+            model.score_counts(mixture.counts()));
+
+        const size_t group_count = mixture.counts().size();
+        actual.resize(group_count);
+        expected.resize(group_count);
+        mixture.score_value(model, actual);
+        driver.score_value(model, expected);
+        for (size_t groupid = 0; groupid < group_count; ++groupid) {
+            assert_close(actual[groupid], expected[groupid]);
+        }
+    }
+}
+
+// sample_posterior_assignments must continue the CRP from the given counts:
+// it updates counts in place, never chooses empty groups, appends new groups
+// in order, and picks groups with the PitmanYor predictive probabilities.
+void test_sample_posterior_assignments(
+        const PitmanYor & model,
+        rng_t & rng) {
+    const std::vector<int> init_counts = {5, 0, 3};
+    std::vector<int> counts = init_counts;
+    const int size = 2000;
+    const auto assignments =
+        model.sample_posterior_assignments(counts, size, rng);
+    DIST_ASSERT_EQ(assignments.size(), static_cast<size_t>(size));
+    std::vector<int> expected = init_counts;
+    for (int groupid : assignments) {
+        DIST_ASSERT_NE(groupid, 1);
+        DIST_ASSERT_LE(static_cast<size_t>(groupid), expected.size());
+        if (static_cast<size_t>(groupid) == expected.size()) {
+            expected.push_back(0);
+        }
+        expected[groupid] += 1;
+    }
+    DIST_ASSERT(counts == expected, "counts were not updated in place");
+    DIST_ASSERT_LT(init_counts.size(), counts.size());
+
+    // a single row joins group 0, group 2 or a new group with probabilities
+    // proportional to 5 - d, 3 - d and alpha + 2 d
+    const double total = 5 + 3 + model.alpha;
+    const double probs[] = {
+        (5 - model.d) / total,
+        0,
+        (3 - model.d) / total,
+        (model.alpha + 2 * model.d) / total};
+    const int trials = 10000;
+    std::vector<int> hits(4, 0);
+    for (int i = 0; i < trials; ++i) {
+        counts = init_counts;
+        hits[model.sample_posterior_assignments(counts, 1, rng)[0]] += 1;
+    }
+    for (size_t groupid = 0; groupid < 4; ++groupid) {
+        const double freq = static_cast<double>(hits[groupid]) / trials;
+        DIST_ASSERT(
+            fabs(freq - probs[groupid]) < 0.02,
+            "group " << groupid << " chosen with frequency " << freq
+            << ", expected " << probs[groupid]);
+    }
+}
+
+int main() {
+    rng_t rng;
+    test_count_histogram();
+
+    PitmanYor pitman_yor;
+    pitman_yor.alpha = 2.0;
+    pitman_yor.d = 0.1;
+    test_score_histogram(pitman_yor, rng);
+    test_cached_mixture(pitman_yor, rng);
+    test_sample_posterior_assignments(pitman_yor, rng);
+
+    LowEntropy low_entropy;
+    low_entropy.dataset_size = 10000;
+    test_score_histogram(low_entropy, rng);
+    test_cached_mixture(low_entropy, rng);
+
+    return 0;
+}
@@ -0,0 +1,146 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <distributions/common.hpp>
+#include <distributions/parallel.hpp>
+#include <distributions/random.hpp>
+#include <distributions/io/dataset.hpp>
+#include <distributions/models/bb.hpp>
+#include <distributions/models/dd.hpp>
+#include <distributions/models/gp.hpp>
+#include <distributions/models/nich.hpp>
+
+using namespace distributions;  // NOLINT(*)
+
+const std::string filename = "test_dataset.snap";
+const size_t row_count = 20000;
+const size_t group_count = 300;
+
+void write_dataset() {
+    rng_t rng(0);
+    std::vector<uint32_t> assignments(row_count);
+    std::vector<uint32_t> counts(row_count);
+    std::vector<int> categories(row_count);
+    std::vector<float> reals(row_count);
+    std::vector<char> bools(row_count);
+    std::vector<uint64_t> missing(dataset_missing_size(row_count), 0);
+    for (size_t row = 0; row < row_count; ++row) {
+        assignments[row] = rng() % group_count;
+        counts[row] = rng() % 7;
+        categories[row] = rng() % 16;
+        reals[row] = 3 * sample_unif01(rng);
+        bools[row] = rng() % 2;
+        if (rng() % 10 == 0) {
+            missing[row / 64] |= uint64_t(1) << (row % 64);
+        }
+    }
+
+    SnapshotWriter writer;
+    writer.add_array("assignments", assignments.data(), row_count);
+    dataset_add_column(writer, "counts", counts.data(), row_count,
+        missing.data());
+    dataset_add_column(writer, "categories", categories.data(), row_count);
+    dataset_add_column(writer, "reals", reals.data(), row_count,
+        missing.data());
+    dataset_add_column(writer, "bools",
+        reinterpret_cast<const bool *>(bools.data()), row_count);
+    writer.write(filename);
+}
+
+// dataset_build_mixture must match adding each present row in order,
+// and must not depend on the thread count
+template<class Model>
+void test_build_mixture(
+        const SnapshotReader & reader,
+        const std::string & name) {
+    rng_t rng(0);
+    const auto shared = Model::Shared::EXAMPLE();
+    const auto assignments = dataset_assignments(reader);
+    const auto column = dataset_column<typename Model::Value>(reader, name);
+
+    typename Model::Mixture expected;
+    expected.groups().resize(group_count);
+    for (auto & group : expected.groups()) {
+        group.init(shared, rng);
+    }
+    for (size_t row = 0; row < row_count; ++row) {
+        if (not column.is_missing(row)) {
+            expected.groups(assignments[row]).add_value(
+                shared,
+                column.values[row],
+                rng);
+        }
+    }
+    expected.init(shared, rng);
+    const float expected_score = expected.score_data(shared, rng);
+
+    std::vector<typename Model::Mixture> actual(2);
+    const size_t thread_counts[] = {1, 4};
+    for (size_t i = 0; i < 2; ++i) {
+        set_thread_count(thread_counts[i]);
+        dataset_build_mixture(
+            shared,
+            assignments,
+            column,
+            group_count,
+            actual[i],
+            rng);
+        actual[i].validate(shared);
+        const float actual_score = actual[i].score_data(shared, rng);
+        DIST_ASSERT_LE(
+            fabs(actual_score - expected_score),
+            1e-5 * (1 + fabs(expected_score)));
+    }
+    set_thread_count(0);
+
+    for (size_t groupid = 0; groupid < group_count; ++groupid) {
+        DIST_ASSERT(
+            memcmp(
+                & actual[0].groups(groupid),
+                & actual[1].groups(groupid),
+                sizeof(typename Model::Group)) == 0,
+            "group " << groupid << " depends on thread count");
+    }
+}
+
+int main() {
+    write_dataset();
+    {
+        SnapshotReader reader(filename);
+        test_build_mixture<GammaPoisson>(reader, "counts");
+        test_build_mixture<DirichletDiscrete<16>>(reader, "categories");
+        test_build_mixture<NormalInverseChiSq>(reader, "reals");
+        test_build_mixture<BetaBernoulli>(reader, "bools");
+    }
+    remove(filename.c_str());
+    return 0;
+}
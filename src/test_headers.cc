@@ -3,8 +3,15 @@
 #include <distributions/clustering.hpp>
 #include <distributions/common.hpp>
 #include <distributions/cython.hpp>
+#include <distributions/io/dataset.hpp>
+#include <distributions/io/parallel.hpp>
+#include <distributions/io/repeated.hpp>
+#include <distributions/io/snapshot.hpp>
+#include <distributions/io/stream.hpp>
+#include <distributions/io/varint.hpp>
 #include <distributions/mixins.hpp>
 #include <distributions/mixture.hpp>
+#include <distributions/mixture_sampler.hpp>
 #include <distributions/models/bb.hpp>
 #include <distributions/models/bnb.hpp>
 #include <distributions/models/dd.hpp>
@@ -12,6 +19,7 @@
 #include <distributions/models/gp.hpp>
 #include <distributions/models/nich.hpp>
 #include <distributions/models/niw.hpp>
+#include <distributions/parallel.hpp>
 #include <distributions/random_fwd.hpp>
 #include <distributions/random.hpp>
 #include <distributions/sparse.hpp>
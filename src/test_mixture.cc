@@ -0,0 +1,842 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <distributions/common.hpp>
+#include <distributions/parallel.hpp>
+#include <distributions/random.hpp>
+#include <distributions/vector.hpp>
+#include <distributions/models/bb.hpp>
+#include <distributions/models/bnb.hpp>
+#include <distributions/models/dd.hpp>
+#include <distributions/models/dpd.hpp>
+#include <distributions/models/gp.hpp>
+#include <distributions/models/nich.hpp>
+#include <distributions/models/niw.hpp>
+
+using namespace distributions;  // NOLINT(*)
+
+template<class Mixture>
+void init_mixture(
+        const typename Mixture::Shared & shared,
+        size_t group_count,
+        Mixture & mixture,
+        rng_t & rng) {
+    mixture.groups().resize(group_count);
+    for (auto & group : mixture.groups()) {
+        group.init(shared, rng);
+    }
+    mixture.init(shared, rng);
+}
+
+// adds values sampled from the shared prior to random groups
+template<class Model>
+void add_example_values(
+        const typename Model::Shared & shared,
+        size_t value_count,
+        typename Model::FastMixture & mixture,
+        rng_t & rng) {
+    typename Model::Group prior;
+    prior.init(shared, rng);
+    for (size_t i = 0; i < value_count; ++i) {
+        const size_t groupid = rng() % mixture.groups().size();
+        const auto value = prior.sample_value(shared, rng);
+        mixture.add_value(shared, groupid, value, rng);
+    }
+}
+
+// the mixture-wide data scorers must agree with Group::score_data
+template<class Model>
+void test_score_data() {
+    rng_t rng(0);
+    const auto shared = Model::Shared::EXAMPLE();
+    typename Model::FastMixture mixture;
+    init_mixture(shared, 20, mixture, rng);
+    add_example_values<Model>(shared, 1000, mixture, rng);
+
+    float expected = 0;
+    for (const auto & group : mixture.groups()) {
+        expected += group.score_data(shared, rng);
+    }
+    const float actual = mixture.score_data(shared, rng);
+    DIST_ASSERT_LT(fabs(actual - expected), 1e-4 * (1 + fabs(expected)));
+}
+
+// DPD groups may carry data debt: negative counts from removing values
+// that were never added
+void test_dpd_data_debt() {
+    typedef DirichletProcessDiscrete Model;
+    rng_t rng(0);
+    const auto shared = Model::Shared::EXAMPLE();
+    Model::FastMixture mixture;
+    init_mixture(shared, 1, mixture, rng);
+    mixture.remove_value(shared, 0, 1, rng);
+    mixture.add_value(shared, 0, 2, rng);
+    mixture.add_value(shared, 0, 3, rng);
+
+    const auto & group = mixture.groups(0);
+    DIST_ASSERT_EQ(group.counts.get_count(1), -1);
+    const float alpha = shared.alpha;
+    float expected = fast_lgamma(alpha) - fast_lgamma(alpha + 1);
+    for (Model::Value value : {1, 2, 3}) {
+        const float prior = alpha * shared.betas.get(value);
+        const count_t count = group.counts.get_count(value);
+        expected += fast_lgamma(prior + count) - fast_lgamma(prior);
+    }
+    const float tol = 1e-4 * (1 + fabs(expected));
+    DIST_ASSERT_LT(fabs(group.score_data(shared, rng) - expected), tol);
+    DIST_ASSERT_LT(fabs(mixture.score_data(shared, rng) - expected), tol);
+}
+
+// FastMixture caches rank-updated Cholesky factors; over a long run of
+// add/remove pairs they must stay as accurate as scoring from the groups.
+template<int dim>
+void test_niw_fast_matches_small() {
+    typedef NormalInverseWishart<dim> Model;
+    rng_t rng(0);
+    const auto shared = Model::Shared::EXAMPLE();
+    const size_t group_count = 2;
+    typename Model::SmallMixture small;
+    typename Model::FastMixture fast;
+    small.groups().resize(group_count);
+    fast.groups().resize(group_count);
+    for (size_t i = 0; i < group_count; ++i) {
+        small.groups(i).init(shared, rng);
+        fast.groups(i).init(shared, rng);
+    }
+    small.init(shared, rng);
+    fast.init(shared, rng);
+
+    std::normal_distribution<float> normal;
+    auto sample = [&]() {
+        typename Model::Value value(shared.dim());
+        for (int i = 0; i < value.size(); ++i) {
+            value(i) = normal(rng);
+        }
+        return value;
+    };
+    std::vector<std::vector<typename Model::Value>> values(group_count);
+    for (size_t i = 0; i < group_count; ++i) {
+        for (size_t j = 0; j < 100; ++j) {
+            values[i].push_back(sample());
+            small.add_value(shared, i, values[i].back(), rng);
+            fast.add_value(shared, i, values[i].back(), rng);
+        }
+    }
+
+    VectorFloat small_scores(group_count);
+    VectorFloat fast_scores(group_count);
+    for (size_t step = 0; step < 100000; ++step) {
+        const size_t groupid = step % group_count;
+        auto & group_values = values[groupid];
+        const size_t pos = rng() % group_values.size();
+        small.remove_value(shared, groupid, group_values[pos], rng);
+        fast.remove_value(shared, groupid, group_values[pos], rng);
+        group_values[pos] = sample();
+        small.add_value(shared, groupid, group_values[pos], rng);
+        fast.add_value(shared, groupid, group_values[pos], rng);
+
+        if (step % 1000 == 0) {
+            const auto value = sample();
+            std::fill(small_scores.begin(), small_scores.end(), 0.f);
+            std::fill(fast_scores.begin(), fast_scores.end(), 0.f);
+            small.score_value(shared, value, small_scores, rng);
+            fast.score_value(shared, value, fast_scores, rng);
+            for (size_t i = 0; i < group_count; ++i) {
+                DIST_ASSERT_LT(fabs(small_scores[i] - fast_scores[i]), 2e-4);
+            }
+        }
+    }
+}
+
+inline void assert_scores_close(
+        const VectorFloat & actual,
+        const VectorFloat & expected) {
+    DIST_ASSERT_EQ(actual.size(), expected.size());
+    for (size_t i = 0; i < actual.size(); ++i) {
+        DIST_ASSERT_LT(
+            fabs(actual[i] - expected[i]),
+            1e-3 * (1 + fabs(expected[i])));
+    }
+}
+
+// remove_and_score_value + move_value must agree with remove_value,
+// score_value, add_value
+template<class Model>
+void test_move_value() {
+    rng_t rng(0);
+    const auto shared = Model::Shared::EXAMPLE();
+    const size_t group_count = 5;
+    typename Model::FastMixture actual;
+    typename Model::FastMixture expected;
+    init_mixture(shared, group_count, actual, rng);
+    init_mixture(shared, group_count, expected, rng);
+
+    typename Model::Group prior;
+    prior.init(shared, rng);
+    std::vector<typename Model::Value> values;
+    std::vector<size_t> assignments;
+    for (size_t i = 0; i < 100; ++i) {
+        values.push_back(prior.sample_value(shared, rng));
+        assignments.push_back(rng() % group_count);
+        actual.add_value(shared, assignments.back(), values.back(), rng);
+        expected.add_value(shared, assignments.back(), values.back(), rng);
+    }
+
+    VectorFloat actual_scores(group_count);
+    VectorFloat expected_scores(group_count);
+    for (size_t step = 0; step < 1000; ++step) {
+        const size_t pos = rng() % values.size();
+        const auto & value = values[pos];
+        const size_t old_groupid = assignments[pos];
+        std::fill(actual_scores.begin(), actual_scores.end(), 0.f);
+        std::fill(expected_scores.begin(), expected_scores.end(), 0.f);
+        actual.remove_and_score_value(
+            shared,
+            old_groupid,
+            value,
+            actual_scores,
+            rng);
+        expected.remove_value(shared, old_groupid, value, rng);
+        expected.score_value(shared, value, expected_scores, rng);
+        assert_scores_close(actual_scores, expected_scores);
+
+        const size_t new_groupid =
+            step % 2 ? rng() % group_count : old_groupid;
+        actual.move_value(shared, old_groupid, new_groupid, value, rng);
+        expected.add_value(shared, new_groupid, value, rng);
+        assignments[pos] = new_groupid;
+
+        const auto probe = prior.sample_value(shared, rng);
+        std::fill(actual_scores.begin(), actual_scores.end(), 0.f);
+        std::fill(expected_scores.begin(), expected_scores.end(), 0.f);
+        actual.score_value(shared, probe, actual_scores, rng);
+        expected.score_value(shared, probe, expected_scores, rng);
+        assert_scores_close(actual_scores, expected_scores);
+    }
+}
+
+// a deferred mixture must score like an eager one, whenever it is scored
+template<class Model>
+void test_deferred() {
+    rng_t rng(0);
+    const auto shared = Model::Shared::EXAMPLE();
+    const size_t group_count = 8;
+    typename Model::FastMixture eager;
+    typename Model::FastMixture deferred;
+    init_mixture(shared, group_count, eager, rng);
+    init_mixture(shared, group_count, deferred, rng);
+    deferred.set_deferred(shared, true, rng);
+    // DPD's value scorer keeps ref counts, so it stays eager
+    const bool is_dpd = std::is_same<Model, DirichletProcessDiscrete>::value;
+    DIST_ASSERT_EQ(deferred.deferred(), not is_dpd);
+
+    typename Model::Group prior;
+    prior.init(shared, rng);
+    std::vector<typename Model::Value> values;
+    std::vector<size_t> assignments;
+    VectorFloat eager_scores;
+    VectorFloat deferred_scores;
+    for (size_t step = 0; step < 2000; ++step) {
+        const size_t size = eager.groups().size();
+        if (values.empty() or step % 3) {
+            values.push_back(prior.sample_value(shared, rng));
+            assignments.push_back(rng() % size);
+            eager.add_value(shared, assignments.back(), values.back(), rng);
+            deferred.add_value(
+                shared,
+                assignments.back(),
+                values.back(),
+                rng);
+        } else {
+            const size_t pos = rng() % values.size();
+            eager.remove_value(shared, assignments[pos], values[pos], rng);
+            deferred.remove_value(
+                shared,
+                assignments[pos],
+                values[pos],
+                rng);
+            values[pos] = values.back();
+            assignments[pos] = assignments.back();
+            values.pop_back();
+            assignments.pop_back();
+        }
+
+        // groups are added and removed while others are dirty
+        if (step % 97 == 0) {
+            eager.add_group(shared, rng);
+            deferred.add_group(shared, rng);
+        } else if (step % 101 == 0) {
+            const size_t groupid = rng() % size;
+            const size_t moved = size - 1;
+            for (size_t pos = 0; pos < values.size(); ++pos) {
+                if (assignments[pos] == groupid) {
+                    eager.remove_value(shared, groupid, values[pos], rng);
+                    deferred.remove_value(shared, groupid, values[pos], rng);
+                    assignments[pos] = (groupid + 1) % size;
+                    eager.add_value(
+                        shared,
+                        assignments[pos],
+                        values[pos],
+                        rng);
+                    deferred.add_value(
+                        shared,
+                        assignments[pos],
+                        values[pos],
+                        rng);
+                }
+            }
+            eager.remove_group(shared, groupid);
+            deferred.remove_group(shared, groupid);
+            for (auto & other : assignments) {
+                if (other == moved) {
+                    other = groupid;
+                }
+            }
+        }
+
+        if (step % 7 == 0) {
+            const auto probe = prior.sample_value(shared, rng);
+            eager_scores.resize(eager.groups().size());
+            deferred_scores.resize(deferred.groups().size());
+            std::fill(eager_scores.begin(), eager_scores.end(), 0.f);
+            std::fill(deferred_scores.begin(), deferred_scores.end(), 0.f);
+            eager.score_value(shared, probe, eager_scores, rng);
+            deferred.score_value(shared, probe, deferred_scores, rng);
+            assert_scores_close(deferred_scores, eager_scores);
+        }
+    }
+}
+
+template<class Mixture>
+void assert_same_scores(
+        const typename Mixture::Shared & shared,
+        const Mixture & actual,
+        const Mixture & expected,
+        const typename Mixture::Value & value,
+        rng_t & rng) {
+    VectorFloat actual_scores(actual.groups().size(), 0.f);
+    VectorFloat expected_scores(expected.groups().size(), 0.f);
+    actual.score_value(shared, value, actual_scores, rng);
+    expected.score_value(shared, value, expected_scores, rng);
+    assert_scores_close(actual_scores, expected_scores);
+}
+
+// copies and their source must each score like an independently built
+// mixture, however each is mutated after the copy, even concurrently
+template<class Model>
+void test_copy() {
+    typedef typename Model::FastMixture Mixture;
+    const auto shared = Model::Shared::EXAMPLE();
+    const size_t group_count = 8;
+    const size_t copy_count = 4;
+    rng_t rng(0);
+    Mixture source;
+    init_mixture(shared, group_count, source, rng);
+    typename Model::Group prior;
+    prior.init(shared, rng);
+    for (size_t i = 0; i < 100; ++i) {
+        const size_t groupid = rng() % group_count;
+        source.add_value(shared, groupid, prior.sample_value(shared, rng), rng);
+    }
+
+    std::vector<Mixture> copies(copy_count, source);
+    std::vector<Mixture> expected(copy_count);
+    const Mixture & const_source = source;
+    for (size_t i = 0; i < copy_count; ++i) {
+        const Mixture & copy = copies[i];
+        DIST_ASSERT(
+            &copy.groups() == &const_source.groups(),
+            "copy " << i << " copied groups before any write");
+        expected[i].groups() = const_source.groups();
+        expected[i].init(shared, rng);
+    }
+
+    // each copy is written from its own thread, the source from this one
+    auto mutate = [&](Mixture & mixture, rng_t & rng) {
+        for (size_t i = 0; i < 100; ++i) {
+            const size_t groupid = rng() % mixture.groups().size();
+            const auto value = prior.sample_value(shared, rng);
+            mixture.add_value(shared, groupid, value, rng);
+        }
+        mixture.add_group(shared, rng);
+        mixture.add_group(shared, rng);
+        mixture.remove_group(shared, group_count);
+    };
+    std::vector<std::function<void()>> tasks;
+    for (size_t i = 0; i < copy_count; ++i) {
+        tasks.push_back([&, i]() {
+            rng_t copy_rng = rng_stream(1, i);
+            mutate(copies[i], copy_rng);
+        });
+    }
+    tasks.push_back([&]() {
+        rng_t source_rng = rng_stream(2, 0);
+        mutate(source, source_rng);
+    });
+    parallel_tasks(tasks);
+
+    Mixture expected_source;
+    expected_source.groups() = expected[0].groups();
+    expected_source.init(shared, rng);
+    rng_t source_rng = rng_stream(2, 0);
+    mutate(expected_source, source_rng);
+    for (size_t i = 0; i < copy_count; ++i) {
+        const Mixture & copy = copies[i];
+        DIST_ASSERT(
+            &copy.groups() != &const_source.groups(),
+            "copy " << i << " shares groups after a write");
+        rng_t copy_rng = rng_stream(1, i);
+        mutate(expected[i], copy_rng);
+    }
+
+    for (size_t i = 0; i < 10; ++i) {
+        const auto probe = prior.sample_value(shared, rng);
+        assert_same_scores(shared, source, expected_source, probe, rng);
+        for (size_t j = 0; j < copy_count; ++j) {
+            assert_same_scores(shared, copies[j], expected[j], probe, rng);
+        }
+    }
+    source.validate(shared);
+    for (const auto & copy : copies) {
+        copy.validate(shared);
+    }
+}
+
+// a fork must keep scoring like its source did at the fork, sharing its
+// groups, however the source is mutated later
+template<class Model>
+void test_fork() {
+    typedef typename Model::FastMixture Mixture;
+    rng_t rng(0);
+    const auto shared = Model::Shared::EXAMPLE();
+    const size_t group_count = 8;
+    Mixture source;
+    Mixture expected;
+    init_mixture(shared, group_count, source, rng);
+    init_mixture(shared, group_count, expected, rng);
+
+    typename Model::Group prior;
+    prior.init(shared, rng);
+    std::vector<typename Model::Value> values;
+    std::vector<size_t> assignments;
+    for (size_t i = 0; i < 100; ++i) {
+        values.push_back(prior.sample_value(shared, rng));
+        assignments.push_back(rng() % group_count);
+        source.add_value(shared, assignments.back(), values.back(), rng);
+        expected.add_value(shared, assignments.back(), values.back(), rng);
+    }
+
+    const Mixture fork = source.fork();
+    DIST_ASSERT(fork.read_only(), "fork is writable");
+    DIST_ASSERT(not source.read_only(), "fork made its source read-only");
+    const std::vector<typename Model::Group> * forked_groups = &fork.groups();
+    DIST_ASSERT(
+        forked_groups == &static_cast<const Mixture &>(source).groups(),
+        "fork copied groups");
+
+    for (size_t i = 0; i < 100; ++i) {
+        const size_t groupid = rng() % group_count;
+        source.add_value(shared, groupid, prior.sample_value(shared, rng), rng);
+    }
+    source.add_group(shared, rng);
+    DIST_ASSERT(forked_groups == &fork.groups(), "fork lost its groups");
+    DIST_ASSERT_EQ(fork.groups().size(), group_count);
+
+    for (size_t i = 0; i < 10; ++i) {
+        const auto probe = prior.sample_value(shared, rng);
+        assert_same_scores(shared, fork, expected, probe, rng);
+        VectorFloat actual_scores(group_count, 0.f);
+        VectorFloat expected_scores(group_count, 0.f);
+        const size_t pos = rng() % values.size();
+        fork.remove_and_score_value(
+            shared,
+            assignments[pos],
+            values[pos],
+            actual_scores,
+            rng);
+        expected.remove_and_score_value(
+            shared,
+            assignments[pos],
+            values[pos],
+            expected_scores,
+            rng);
+        assert_scores_close(actual_scores, expected_scores);
+    }
+    fork.validate(shared);
+}
+
+// a frozen mixture must score like its source at freeze time, and must not
+// see later writes to the source
+template<class Model>
+void test_freeze() {
+    typedef typename Model::FastMixture Mixture;
+    rng_t rng(0);
+    const auto shared = Model::Shared::EXAMPLE();
+    const size_t group_count = 8;
+    Mixture source;
+    Mixture expected;
+    init_mixture(shared, group_count, source, rng);
+    init_mixture(shared, group_count, expected, rng);
+    source.set_deferred(shared, true, rng);
+
+    typename Model::Group prior;
+    prior.init(shared, rng);
+    for (size_t i = 0; i < 100; ++i) {
+        const size_t groupid = rng() % group_count;
+        const auto value = prior.sample_value(shared, rng);
+        source.add_value(shared, groupid, value, rng);
+        expected.add_value(shared, groupid, value, rng);
+    }
+    const auto frozen = source.freeze(shared, rng);
+    DIST_ASSERT_EQ(frozen.size(), group_count);
+
+    for (size_t i = 0; i < 100; ++i) {
+        const size_t groupid = rng() % group_count;
+        source.add_value(shared, groupid, prior.sample_value(shared, rng), rng);
+    }
+    source.add_group(shared, rng);
+
+    VectorFloat actual_scores(group_count);
+    VectorFloat expected_scores(group_count);
+    for (size_t i = 0; i < 10; ++i) {
+        const auto probe = prior.sample_value(shared, rng);
+        std::fill(actual_scores.begin(), actual_scores.end(), 0.f);
+        std::fill(expected_scores.begin(), expected_scores.end(), 0.f);
+        frozen.score_value(probe, actual_scores);
+        expected.score_value(shared, probe, expected_scores, rng);
+        assert_scores_close(actual_scores, expected_scores);
+
+        for (size_t groupid = 0; groupid < group_count; ++groupid) {
+            actual_scores[groupid] = frozen.score_value_group(groupid, probe);
+            expected_scores[groupid] =
+                expected.score_value_group(shared, groupid, probe, rng);
+        }
+        assert_scores_close(actual_scores, expected_scores);
+
+        // a row of two features, both observing probe
+        std::fill(actual_scores.begin(), actual_scores.end(), 0.f);
+        std::fill(expected_scores.begin(), expected_scores.end(), 0.f);
+        score_row(actual_scores, frozen, probe, frozen, probe);
+        expected.score_value(shared, probe, expected_scores, rng);
+        expected.score_value(shared, probe, expected_scores, rng);
+        assert_scores_close(actual_scores, expected_scores);
+    }
+}
+
+typedef MixtureIdTracker::Id Id;
+
+// the map-based id tracker that MixtureIdTracker replaced, as a reference
+struct MapIdTracker {
+    std::vector<Id> packed_to_global;
+    std::unordered_map<Id, Id> global_to_packed;
+    Id global_size = 0;
+
+    void add_group() {
+        global_to_packed[global_size] = packed_to_global.size();
+        packed_to_global.push_back(global_size++);
+    }
+
+    void remove_group(Id packed) {
+        global_to_packed.erase(packed_to_global[packed]);
+        packed_to_global[packed] = packed_to_global.back();
+        packed_to_global.pop_back();
+        if (packed != packed_to_global.size()) {
+            global_to_packed[packed_to_global[packed]] = packed;
+        }
+    }
+};
+
+void assert_same_ids(
+        const MixtureIdTracker & actual,
+        const MapIdTracker & expected) {
+    DIST_ASSERT_EQ(actual.packed_size(), expected.packed_to_global.size());
+    DIST_ASSERT_EQ(actual.global_size(), expected.global_size);
+    DIST_ASSERT_EQ(
+        actual.tombstone_count(),
+        expected.global_size - expected.global_to_packed.size());
+    for (Id packed = 0; packed < actual.packed_size(); ++packed) {
+        DIST_ASSERT_EQ(
+            actual.packed_to_global(packed),
+            expected.packed_to_global[packed]);
+    }
+    for (Id global = 0; global < actual.global_size(); ++global) {
+        const auto i = expected.global_to_packed.find(global);
+        const bool live = (i != expected.global_to_packed.end());
+        DIST_ASSERT_EQ(actual.has_global(global), live);
+        if (live) {
+            DIST_ASSERT_EQ(actual.global_to_packed(global), i->second);
+        }
+    }
+}
+
+// random adds and removes must translate ids exactly as the map did
+void test_id_tracker_matches_map() {
+    rng_t rng(0);
+    MixtureIdTracker actual;
+    MapIdTracker expected;
+    actual.init(10);
+    for (size_t i = 0; i < 10; ++i) {
+        expected.add_group();
+    }
+    assert_same_ids(actual, expected);
+    for (size_t step = 0; step < 1000; ++step) {
+        if (actual.packed_size() == 0 or rng() % 3 == 0) {
+            actual.add_group();
+            expected.add_group();
+        } else {
+            const Id packed = rng() % actual.packed_size();
+            actual.remove_group(packed);
+            expected.remove_group(packed);
+        }
+        assert_same_ids(actual, expected);
+    }
+}
+
+// compact() must renumber live global ids in order, report each change,
+// and leave both directions consistent
+void test_id_tracker_compact() {
+    MixtureIdTracker ids;
+    ids.init(8);
+    ids.remove_group(ids.global_to_packed(1));
+    ids.remove_group(ids.global_to_packed(5));
+    ids.remove_group(ids.global_to_packed(7));
+    DIST_ASSERT_EQ(ids.packed_size(), 5);
+    DIST_ASSERT_EQ(ids.tombstone_count(), 3);
+
+    std::vector<Id> old_globals(ids.packed_size());
+    for (Id packed = 0; packed < ids.packed_size(); ++packed) {
+        old_globals[packed] = ids.packed_to_global(packed);
+    }
+    std::unordered_map<Id, Id> renumbered;
+    std::vector<std::pair<Id, Id>> changes;
+    ids.compact([&](Id old_global, Id new_global) {
+        renumbered[old_global] = new_global;
+        changes.push_back(std::make_pair(old_global, new_global));
+    });
+    const std::vector<std::pair<Id, Id>> expected_changes = {
+        {2, 1}, {3, 2}, {4, 3}, {6, 4}};
+    DIST_ASSERT(changes == expected_changes, "wrong renumbering");
+    DIST_ASSERT_EQ(ids.global_size(), 5);
+    DIST_ASSERT_EQ(ids.tombstone_count(), 0);
+    for (Id packed = 0; packed < ids.packed_size(); ++packed) {
+        const Id old_global = old_globals[packed];
+        const Id new_global = renumbered.count(old_global)
+                            ? renumbered[old_global]
+                            : old_global;
+        DIST_ASSERT_EQ(ids.packed_to_global(packed), new_global);
+        DIST_ASSERT_EQ(ids.global_to_packed(new_global), packed);
+    }
+
+    // new groups continue after the compacted ids
+    ids.add_group();
+    DIST_ASSERT_EQ(ids.packed_to_global(5), 5);
+    DIST_ASSERT_EQ(ids.global_to_packed(5), 5);
+
+    // compacting without tombstones renumbers nothing
+    changes.clear();
+    ids.compact([&](Id old_global, Id new_global) {
+        changes.push_back(std::make_pair(old_global, new_global));
+    });
+    DIST_ASSERT(changes.empty(), "renumbered without tombstones");
+    DIST_ASSERT_EQ(ids.global_size(), 6);
+}
+
+// bulk translation must agree with single lookups after tombstones
+void test_id_tracker_bulk() {
+    rng_t rng(0);
+    MixtureIdTracker ids;
+    ids.init(100);
+    for (size_t i = 0; i < 40; ++i) {
+        ids.remove_group(rng() % ids.packed_size());
+    }
+    DIST_ASSERT_EQ(ids.tombstone_count(), 40);
+
+    const size_t size = ids.packed_size();
+    std::vector<Id> packed(size);
+    std::vector<Id> global(size);
+    std::vector<Id> round_trip(size);
+    std::iota(packed.begin(), packed.end(), 0);
+    std::shuffle(packed.begin(), packed.end(), rng);
+    ids.packed_to_global(size, packed.data(), global.data());
+    for (size_t i = 0; i < size; ++i) {
+        DIST_ASSERT_EQ(global[i], ids.packed_to_global(packed[i]));
+        DIST_ASSERT(ids.has_global(global[i]), "stale id: " << global[i]);
+    }
+    ids.global_to_packed(size, global.data(), round_trip.data());
+    DIST_ASSERT(round_trip == packed, "bulk round trip failed");
+
+    size_t stale_count = 0;
+    for (Id id = 0; id < ids.global_size(); ++id) {
+        stale_count += not ids.has_global(id);
+    }
+    DIST_ASSERT_EQ(stale_count, ids.tombstone_count());
+}
+
+// checks a DenseIdSet holds exactly the ids marked in expected, and that
+// its positions stay consistent with its list of members
+void assert_same_id_set(
+        DenseIdSet set,
+        const std::vector<bool> & expected) {
+    size_t expected_size = 0;
+    for (size_t id = 0; id < expected.size(); ++id) {
+        DIST_ASSERT_EQ(set.contains(id), expected[id]);
+        expected_size += expected[id];
+    }
+    DIST_ASSERT_EQ(set.size(), expected_size);
+    std::vector<bool> seen(expected.size(), false);
+    for (size_t id : set) {
+        DIST_ASSERT_LT(id, expected.size());
+        DIST_ASSERT(not seen[id], "duplicate id: " << id);
+        seen[id] = true;
+    }
+
+    // erasing via positions must remove exactly one member at a time
+    while (not set.empty()) {
+        const size_t id = * set.begin();
+        const size_t size = set.size();
+        set.erase(id);
+        DIST_ASSERT(not set.contains(id), "failed to erase id: " << id);
+        DIST_ASSERT_EQ(set.size(), size - 1);
+    }
+}
+
+// mirrors Packed_::packed_remove(id) on a membership vector
+void packed_remove(std::vector<bool> & expected, size_t id) {
+    expected[id] = expected.back();
+    expected.pop_back();
+}
+
+void test_dense_id_set_packed_remove() {
+    DenseIdSet set;
+    std::vector<bool> expected(6, false);
+    for (size_t id : {1, 3, 5}) {
+        set.insert(id);
+        expected[id] = true;
+    }
+    assert_same_id_set(set, expected);
+
+    // removing the last element just drops it
+    set.packed_remove(5, 5);
+    packed_remove(expected, 5);
+    assert_same_id_set(set, expected);
+
+    // a present last element moves into a present middle element
+    set.insert(4);
+    expected[4] = true;
+    set.packed_remove(1, 4);
+    packed_remove(expected, 1);
+    assert_same_id_set(set, expected);
+
+    // a present last element moves into an absent middle element
+    set.packed_remove(0, 3);
+    packed_remove(expected, 0);
+    assert_same_id_set(set, expected);
+    DIST_ASSERT(set.contains(0), "moved element was lost");
+
+    // an absent last element leaves a present middle element absent
+    set.packed_remove(0, 2);
+    packed_remove(expected, 0);
+    assert_same_id_set(set, expected);
+
+    rng_t rng(0);
+    expected.assign(100, false);
+    set.clear();
+    for (size_t id = 0; id < expected.size(); ++id) {
+        if (rng() % 2) {
+            set.insert(id);
+            expected[id] = true;
+        }
+    }
+    while (not expected.empty()) {
+        const size_t id = rng() % expected.size();
+        set.packed_remove(id, expected.size() - 1);
+        packed_remove(expected, id);
+        assert_same_id_set(set, expected);
+    }
+    DIST_ASSERT(set.empty(), "expected empty set");
+}
+
+int main() {
+    test_score_data<BetaBernoulli>();
+    test_score_data<BetaNegativeBinomial>();
+    test_score_data<DirichletDiscrete<16>>();
+    test_score_data<DirichletProcessDiscrete>();
+    test_score_data<GammaPoisson>();
+    test_score_data<NormalInverseChiSq>();
+    test_dpd_data_debt();
+    test_niw_fast_matches_small<2>();
+    test_niw_fast_matches_small<3>();
+    test_niw_fast_matches_small<-1>();
+    test_move_value<BetaBernoulli>();
+    test_move_value<BetaNegativeBinomial>();
+    test_move_value<DirichletDiscrete<16>>();
+    test_move_value<DirichletProcessDiscrete>();
+    test_move_value<GammaPoisson>();
+    test_move_value<NormalInverseChiSq>();
+    test_move_value<NormalInverseWishart<3>>();
+    test_deferred<BetaBernoulli>();
+    test_deferred<BetaNegativeBinomial>();
+    test_deferred<DirichletDiscrete<16>>();
+    test_deferred<DirichletProcessDiscrete>();
+    test_deferred<GammaPoisson>();
+    test_deferred<NormalInverseChiSq>();
+    test_deferred<NormalInverseWishart<-1>>();
+    test_copy<BetaBernoulli>();
+    test_copy<BetaNegativeBinomial>();
+    test_copy<DirichletDiscrete<16>>();
+    test_copy<DirichletProcessDiscrete>();
+    test_copy<GammaPoisson>();
+    test_copy<NormalInverseChiSq>();
+    test_copy<NormalInverseWishart<-1>>();
+    test_fork<BetaBernoulli>();
+    test_fork<BetaNegativeBinomial>();
+    test_fork<DirichletDiscrete<16>>();
+    test_fork<DirichletProcessDiscrete>();
+    test_fork<GammaPoisson>();
+    test_fork<NormalInverseChiSq>();
+    test_fork<NormalInverseWishart<-1>>();
+    test_freeze<BetaBernoulli>();
+    test_freeze<BetaNegativeBinomial>();
+    test_freeze<DirichletDiscrete<16>>();
+    test_freeze<DirichletProcessDiscrete>();
+    test_freeze<GammaPoisson>();
+    test_freeze<NormalInverseChiSq>();
+    test_freeze<NormalInverseWishart<-1>>();
+    test_id_tracker_matches_map();
+    test_id_tracker_compact();
+    test_id_tracker_bulk();
+    test_dense_id_set_packed_remove();
+    return 0;
+}
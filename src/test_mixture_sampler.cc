@@ -0,0 +1,141 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <math.h>
+#include <vector>
+#include <distributions/common.hpp>
+#include <distributions/mixture_sampler.hpp>
+#include <distributions/parallel.hpp>
+#include <distributions/random.hpp>
+#include <distributions/models/bnb.hpp>
+#include <distributions/models/dd.hpp>
+#include <distributions/models/dpd.hpp>
+#include <distributions/models/gp.hpp>
+#include <distributions/models/nich.hpp>
+
+using namespace distributions;  // NOLINT(*)
+
+const size_t group_count = 50;
+const size_t row_count = 20000;
+
+// sampled values must not depend on the thread count, including values
+// from groups added by resize
+template<class Model>
+void test_thread_count() {
+    rng_t rng(0);
+    const auto shared = Model::Shared::EXAMPLE();
+    typename Model::Group prior;
+    prior.init(shared, rng);
+    std::vector<typename Model::Group> groups(group_count);
+    for (auto & group : groups) {
+        group.init(shared, rng);
+        for (size_t i = 0; i < 100; ++i) {
+            group.add_value(shared, prior.sample_value(shared, rng), rng);
+        }
+    }
+    const size_t total_count = group_count + 3;
+    std::vector<uint32_t> assignments(row_count);
+    for (auto & groupid : assignments) {
+        groupid = rng() % total_count;
+    }
+
+    std::vector<std::vector<typename Model::Value>> values(2);
+    const size_t thread_counts[] = {1, 4};
+    for (size_t i = 0; i < 2; ++i) {
+        set_thread_count(thread_counts[i]);
+        rng_t sampler_rng(1);
+        MixtureSampler<Model> sampler;
+        sampler.init(shared, groups, sampler_rng);
+        sampler.resize(shared, total_count, sampler_rng);
+        DIST_ASSERT_EQ(sampler.size(), total_count);
+        values[i].resize(row_count);
+        sampler.sample(
+            shared,
+            assignments.data(),
+            row_count,
+            values[i].data(),
+            sampler_rng);
+    }
+    set_thread_count(0);
+
+    for (size_t row = 0; row < row_count; ++row) {
+        DIST_ASSERT(
+            values[0][row] == values[1][row],
+            "row " << row << " depends on thread count");
+    }
+}
+
+// each group's values must follow that group's posterior predictive
+void test_group_means() {
+    typedef NormalInverseChiSq Model;
+    rng_t rng(0);
+    const auto shared = Model::Shared::EXAMPLE();
+    std::vector<Model::Group> groups(group_count);
+    for (size_t groupid = 0; groupid < group_count; ++groupid) {
+        auto & group = groups[groupid];
+        group.init(shared, rng);
+        for (size_t i = 0; i < 1000; ++i) {
+            group.add_value(shared, sample_normal(rng, groupid, 1.f), rng);
+        }
+    }
+    std::vector<uint32_t> assignments(row_count);
+    for (size_t row = 0; row < row_count; ++row) {
+        assignments[row] = row % group_count;
+    }
+
+    MixtureSampler<Model> sampler;
+    sampler.init(shared, groups, rng);
+    std::vector<Model::Value> values(row_count);
+    sampler.sample(
+        shared,
+        assignments.data(),
+        row_count,
+        values.data(),
+        rng);
+
+    std::vector<double> sums(group_count, 0.0);
+    for (size_t row = 0; row < row_count; ++row) {
+        sums[assignments[row]] += values[row];
+    }
+    const double rows_per_group = row_count / group_count;
+    for (size_t groupid = 0; groupid < group_count; ++groupid) {
+        const double mean = sums[groupid] / rows_per_group;
+        DIST_ASSERT(
+            fabs(mean - groupid) < 0.3,
+            "group " << groupid << " has mean " << mean);
+    }
+}
+
+int main() {
+    test_thread_count<BetaNegativeBinomial>();
+    test_thread_count<DirichletDiscrete<16>>();
+    test_thread_count<DirichletProcessDiscrete>();
+    test_thread_count<GammaPoisson>();
+    test_thread_count<NormalInverseChiSq>();
+    test_group_means();
+    return 0;
+}
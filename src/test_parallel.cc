@@ -0,0 +1,75 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <memory>
+#include <distributions/common.hpp>
+#include <distributions/parallel.hpp>
+
+using namespace distributions;  // NOLINT(*)
+
+// many tiny tasks, so that workers often wake after their task is done
+void test_parallel_for_chunks_stress(size_t thread_count) {
+    set_thread_count(thread_count);
+    const size_t max_size = 200;
+    std::unique_ptr<std::atomic<int>[]> hits(new std::atomic<int>[max_size]);
+    for (size_t trial = 0; trial < 20000; ++trial) {
+        const size_t size = trial % max_size;
+        const size_t min_chunk_size = trial % 7;
+        for (size_t i = 0; i < size; ++i) {
+            hits[i] = 0;
+        }
+        parallel_for_chunks(0, size, min_chunk_size,
+            [&hits](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    ++hits[i];
+                }
+            });
+        for (size_t i = 0; i < size; ++i) {
+            DIST_ASSERT_EQ(hits[i], 1);
+        }
+    }
+}
+
+void test_parallel_tasks() {
+    set_thread_count(4);
+    std::atomic<int> sum(0);
+    std::vector<std::function<void()>> tasks;
+    for (int i = 1; i <= 100; ++i) {
+        tasks.push_back([&sum, i]() { sum += i; });
+    }
+    parallel_tasks(tasks);
+    DIST_ASSERT_EQ(sum, 5050);
+}
+
+int main() {
+    test_parallel_for_chunks_stress(2);
+    test_parallel_for_chunks_stress(8);
+    test_parallel_tasks();
+    set_thread_count(0);
+    return 0;
+}
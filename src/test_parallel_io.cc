@@ -0,0 +1,157 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdio.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include <distributions/common.hpp>
+#include <distributions/parallel.hpp>
+#include <distributions/io/protobuf.hpp>
+#include <distributions/io/parallel.hpp>
+#include <distributions/models/bnb.hpp>
+#include <distributions/models/dpd.hpp>
+#include <distributions/models/gp.hpp>
+#include <distributions/models/nich.hpp>
+
+using namespace distributions;  // NOLINT(*)
+
+// more groups than one parallel_io_batch_size batch
+const size_t group_count = 3 * parallel_io_batch_size / 2;
+
+std::string read_file(const std::string & name) {
+    std::string result;
+    FILE * file = fopen(name.c_str(), "rb");
+    DIST_ASSERT(file, "failed to open " << name);
+    char buffer[4096];
+    while (size_t count = fread(buffer, 1, sizeof(buffer), file)) {
+        result.append(buffer, count);
+    }
+    fclose(file);
+    return result;
+}
+
+template<class Model, class Message>
+void test_round_trip(const std::string & filename) {
+    rng_t rng(0);
+    const auto shared = Model::Shared::EXAMPLE();
+    typename Model::Mixture mixture;
+    mixture.groups().resize(group_count);
+    for (auto & group : mixture.groups()) {
+        group.init(shared, rng);
+        for (size_t i = 0; i < 3; ++i) {
+            group.add_value(shared, group.sample_value(shared, rng), rng);
+        }
+    }
+    mixture.init(shared, rng);
+
+    // the output must not depend on the thread count
+    std::string expected;
+    for (size_t thread_count : {1, 4}) {
+        set_thread_count(thread_count);
+        parallel_dump_mixture<Message>(mixture, filename);
+        const std::string actual = read_file(filename);
+        if (expected.empty()) {
+            expected = actual;
+        } else {
+            DIST_ASSERT(actual == expected, "dump depends on thread count");
+        }
+
+        typename Model::Mixture loaded;
+        parallel_load_mixture<Message>(shared, filename, loaded, rng);
+        DIST_ASSERT_EQ(loaded.groups().size(), group_count);
+        for (size_t groupid = 0; groupid < group_count; ++groupid) {
+            Message expected_message;
+            Message actual_message;
+            mixture.groups(groupid).protobuf_dump(expected_message);
+            loaded.groups(groupid).protobuf_dump(actual_message);
+            DIST_ASSERT_CLOSE(actual_message, expected_message);
+        }
+        loaded.validate(shared);
+    }
+    set_thread_count(0);
+    remove(filename.c_str());
+}
+
+// one feature per task, as when loading a many-feature model
+void test_tasks() {
+    typedef GammaPoisson Model;
+    typedef distributions::protobuf::GammaPoisson::Group Message;
+    const auto shared = Model::Shared::EXAMPLE();
+    const size_t task_count = 8;
+    std::vector<Model::Mixture> mixtures(task_count);
+    std::vector<std::function<void()>> tasks;
+    for (size_t i = 0; i < task_count; ++i) {
+        tasks.push_back([&shared, &mixtures, i]() {
+            const std::string filename =
+                "test_parallel_io." + std::to_string(i) + ".pbs";
+            rng_t rng(i);
+            Model::Mixture mixture;
+            mixture.groups().resize(100 * (i + 1));
+            for (auto & group : mixture.groups()) {
+                group.init(shared, rng);
+                group.add_value(shared, i, rng);
+            }
+            mixture.init(shared, rng);
+            parallel_dump_mixture<Message>(mixture, filename);
+            parallel_load_mixture<Message>(
+                shared,
+                filename,
+                mixtures[i],
+                rng);
+            remove(filename.c_str());
+        });
+    }
+    parallel_tasks(tasks);
+    for (size_t i = 0; i < task_count; ++i) {
+        DIST_ASSERT_EQ(mixtures[i].groups().size(), 100 * (i + 1));
+        for (const auto & group : mixtures[i].groups()) {
+            DIST_ASSERT_EQ(group.count, 1);
+            DIST_ASSERT_EQ(group.sum, i);
+        }
+    }
+}
+
+int main() {
+    namespace messages = distributions::protobuf;
+    const std::string filename = "test_parallel_io.pbs";
+    test_round_trip<GammaPoisson, messages::GammaPoisson::Group>(filename);
+    test_round_trip<NormalInverseChiSq, messages::NormalInverseChiSq::Group>(
+        filename);
+    test_round_trip<
+        BetaNegativeBinomial,
+        messages::BetaNegativeBinomial::Group>(filename);
+    test_round_trip<
+        DirichletProcessDiscrete,
+        messages::DirichletProcessDiscrete::Group>(filename);
+#ifdef USE_ZLIB
+    test_round_trip<GammaPoisson, messages::GammaPoisson::Group>(
+        filename + ".gz");
+#endif  // USE_ZLIB
+    test_tasks();
+    return 0;
+}
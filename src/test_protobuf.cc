@@ -108,8 +108,51 @@ void test_model() {
     DIST_ASSERT_CLOSE(group_message, group_message1);
 }
 
+// groups with data survive a mixture-wide dump and load
+template <typename Model>
+void test_groups() {
+    typedef typename message<Model>::group_message_type Message;
+    auto const shared = Model::Shared::EXAMPLE();
+    distributions::rng_t rng;
+    typename Model::Mixture mixture;
+    mixture.groups().resize(10);
+    for (auto & group : mixture.groups()) {
+        group.init(shared, rng);
+        for (size_t i = 0; i < 20; ++i) {
+            group.add_value(shared, group.sample_value(shared, rng), rng);
+        }
+    }
+    mixture.init(shared, rng);
+
+    google::protobuf::RepeatedPtrField<Message> messages;
+    distributions::protobuf_dump_groups(mixture, messages);
+    DIST_ASSERT_EQ(messages.size(), 10);
+
+    typename Model::Mixture mixture1;
+    distributions::protobuf_load_groups(messages, mixture1);
+    mixture1.init(shared, rng);
+    DIST_ASSERT_EQ(mixture1.groups().size(), 10);
+    for (size_t i = 0; i < 10; ++i) {
+        Message message1;
+        mixture1.groups(i).protobuf_dump(message1);
+        DIST_ASSERT_CLOSE(messages.Get(i), message1);
+    }
+
+#if GOOGLE_PROTOBUF_VERSION >= 3000000
+    google::protobuf::Arena arena;
+    const auto * arena_messages =
+        distributions::protobuf_dump_groups<Message>(arena, mixture);
+    DIST_ASSERT_EQ(arena_messages->size(), 10);
+    for (size_t i = 0; i < 10; ++i) {
+        DIST_ASSERT_CLOSE(messages.Get(i), arena_messages->Get(i));
+    }
+#endif  // GOOGLE_PROTOBUF_VERSION >= 3000000
+}
+
 int main(void) {
-#define DIST_TEST_MODEL(name) test_model<distributions::name>();
+#define DIST_TEST_MODEL(name) \
+    test_model<distributions::name>(); \
+    test_groups<distributions::name>();
     DIST_MODELS(DIST_TEST_MODEL);
 #undef DIST_TEST_MODEL
     return 0;
@@ -0,0 +1,114 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <eigen3/Eigen/Dense>
+#include <distributions/common.hpp>
+#include <distributions/random.hpp>
+
+using namespace distributions;  // NOLINT(*)
+
+typedef Eigen::VectorXf Vector;
+typedef Eigen::MatrixXf Matrix;
+
+void assert_matrix_close(const Matrix & x, const Matrix & y, float tol) {
+    DIST_ASSERT_EQ(x.rows(), y.rows());
+    DIST_ASSERT_EQ(x.cols(), y.cols());
+    const float error = (x - y).cwiseAbs().maxCoeff();
+    DIST_ASSERT(error <= tol * y.cwiseAbs().maxCoeff(),
+        "expected\n" << y << "\nactual\n" << x);
+}
+
+Matrix example_psi() {
+    Matrix psi(3, 3);
+    psi << 2.0, 0.5, 0.0,
+           0.5, 1.0, 0.3,
+           0.0, 0.3, 1.5;
+    return psi;
+}
+
+// E[Wishart(nu, scale)] = nu scale
+void test_sample_wishart_mean() {
+    rng_t rng(0);
+    const Matrix scale = example_psi();
+    const float nu = 6;
+    const size_t sample_count = 20000;
+    Matrix mean = Matrix::Zero(3, 3);
+    for (size_t i = 0; i < sample_count; ++i) {
+        mean += sample_wishart(nu, scale, rng);
+    }
+    mean /= sample_count;
+    assert_matrix_close(mean, nu * scale, 0.05);
+}
+
+// E[InverseWishart(nu, psi)] = psi / (nu - dim - 1)
+void test_sample_inverse_wishart_mean() {
+    rng_t rng(0);
+    const Matrix psi = example_psi();
+    const float nu = 10;
+    const size_t sample_count = 20000;
+    Matrix mean = Matrix::Zero(3, 3);
+    for (size_t i = 0; i < sample_count; ++i) {
+        mean += sample_inverse_wishart(nu, psi, rng);
+    }
+    mean /= sample_count;
+    assert_matrix_close(mean, psi / (nu - 3 - 1), 0.05);
+}
+
+// cov ~ InverseWishart(nu, psi) and mu ~ Normal(mu0, cov / lambda)
+void test_sample_normal_inverse_wishart_moments() {
+    rng_t rng(0);
+    const Matrix psi = example_psi();
+    const Vector mu0 = Vector::Constant(3, 1.f);
+    const float lambda = 4;
+    const float nu = 10;
+    const size_t sample_count = 20000;
+    Matrix cov_mean = Matrix::Zero(3, 3);
+    Vector mu_mean = Vector::Zero(3);
+    Matrix mu_cov = Matrix::Zero(3, 3);
+    for (size_t i = 0; i < sample_count; ++i) {
+        const auto sample =
+            sample_normal_inverse_wishart(mu0, lambda, psi, nu, rng);
+        cov_mean += sample.second;
+        mu_mean += sample.first;
+        const Vector diff = sample.first - mu0;
+        mu_cov += diff * diff.transpose();
+    }
+    cov_mean /= sample_count;
+    mu_mean /= sample_count;
+    mu_cov /= sample_count;
+    const Matrix expected_cov = psi / (nu - 3 - 1);
+    assert_matrix_close(cov_mean, expected_cov, 0.05);
+    assert_matrix_close(mu_cov, expected_cov / lambda, 0.05);
+    DIST_ASSERT_LT((mu_mean - mu0).cwiseAbs().maxCoeff(), 0.02);
+}
+
+int main() {
+    test_sample_wishart_mean();
+    test_sample_inverse_wishart_mean();
+    test_sample_normal_inverse_wishart_moments();
+    return 0;
+}
@@ -0,0 +1,239 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <distributions/common.hpp>
+#include <distributions/random.hpp>
+#include <distributions/vector.hpp>
+#include <distributions/io/snapshot.hpp>
+#include <distributions/models/bb.hpp>
+#include <distributions/models/bnb.hpp>
+#include <distributions/models/dd.hpp>
+#include <distributions/models/gp.hpp>
+#include <distributions/models/nich.hpp>
+
+using namespace distributions;  // NOLINT(*)
+
+const std::string filename = "test_snapshot.snap";
+
+// changes a Shared enough that no cached scorer may be reused with it
+inline void perturb(BetaBernoulli::Shared & shared) { shared.alpha *= 2; }
+inline void perturb(BetaNegativeBinomial::Shared & shared) { shared.r += 1; }
+inline void perturb(DirichletDiscrete<16>::Shared & shared) {
+    shared.alphas[0] *= 2;
+}
+inline void perturb(GammaPoisson::Shared & shared) { shared.alpha *= 2; }
+inline void perturb(NormalInverseChiSq::Shared & shared) {
+    shared.kappa *= 2;
+}
+
+template<class Mixture>
+void assert_same_scores(
+        const typename Mixture::Shared & shared,
+        const Mixture & actual,
+        const Mixture & expected,
+        rng_t & rng,
+        float tol = 0) {
+    DIST_ASSERT_EQ(actual.groups().size(), expected.groups().size());
+    const size_t group_count = expected.groups().size();
+    typename Mixture::Group prior;
+    prior.init(shared, rng);
+    VectorFloat actual_scores(group_count);
+    VectorFloat expected_scores(group_count);
+    for (size_t i = 0; i < 10; ++i) {
+        const auto value = prior.sample_value(shared, rng);
+        std::fill(actual_scores.begin(), actual_scores.end(), 0.f);
+        std::fill(expected_scores.begin(), expected_scores.end(), 0.f);
+        actual.score_value(shared, value, actual_scores, rng);
+        expected.score_value(shared, value, expected_scores, rng);
+        for (size_t groupid = 0; groupid < group_count; ++groupid) {
+            const float expected_score = expected_scores[groupid];
+            DIST_ASSERT_LE(
+                fabs(actual_scores[groupid] - expected_score),
+                tol * (1 + fabs(expected_score)));
+        }
+    }
+}
+
+template<class Model>
+void test_snapshot() {
+    rng_t rng(0);
+    const auto shared = Model::Shared::EXAMPLE();
+    typename Model::FastMixture mixture;
+    mixture.groups().resize(10);
+    for (auto & group : mixture.groups()) {
+        group.init(shared, rng);
+    }
+    mixture.init(shared, rng);
+    for (size_t i = 0; i < 100; ++i) {
+        const size_t groupid = rng() % mixture.groups().size();
+        const auto value =
+            mixture.groups(groupid).sample_value(shared, rng);
+        mixture.add_value(shared, groupid, value, rng);
+    }
+
+    SnapshotWriter writer;
+    mixture.snapshot_dump(shared, writer, "mixture.");
+    writer.write(filename);
+
+    {
+        SnapshotReader reader(filename);
+        DIST_ASSERT(
+            reader.has("mixture.scorer.shared"),
+            "value scorer cache was not dumped");
+        typename Model::FastMixture loaded;
+        loaded.snapshot_load(shared, reader, "mixture.", rng);
+        assert_same_scores(shared, loaded, mixture, rng);
+    }
+
+    // caches dumped with one Shared must not be reused with another
+    {
+        auto other = shared;
+        perturb(other);
+        typename Model::FastMixture expected = mixture;
+        expected.init(other, rng);
+        SnapshotReader reader(filename);
+        typename Model::FastMixture loaded;
+        loaded.snapshot_load(other, reader, "mixture.", rng);
+        assert_same_scores(other, loaded, expected, rng);
+    }
+
+    remove(filename.c_str());
+}
+
+void remove_log(const std::string & path) {
+    const SnapshotLog log(path);
+    for (size_t i = 0; i <= log.delta_count(); ++i) {
+        remove(log.filename(i).c_str());
+    }
+}
+
+// a log of a base snapshot and deltas must replay to the live mixture
+void test_snapshot_log() {
+    typedef GammaPoisson Model;
+    rng_t rng(0);
+    const auto shared = Model::Shared::EXAMPLE();
+    const std::string path = "test_snapshot.log";
+    Model::FastMixture mixture;
+    MixtureIdTracker ids;
+    mixture.groups().resize(100);
+    for (auto & group : mixture.groups()) {
+        group.init(shared, rng);
+    }
+    mixture.init(shared, rng);
+    ids.init(100);
+    mixture.set_track_changes(true);
+
+    remove_log(path);
+    SnapshotLog log(path);
+    size_t delta_count = 0;
+    for (size_t step = 0; step < 40; ++step) {
+        for (size_t i = 0; i < 20; ++i) {
+            const size_t group_count = mixture.groups().size();
+            const size_t groupid = rng() % group_count;
+            switch (rng() % 8) {
+                case 0:
+                    mixture.add_group(shared, rng);
+                    ids.add_group();
+                    break;
+                case 1:
+                    if (group_count > 10) {
+                        mixture.remove_group(shared, groupid);
+                        ids.remove_group(groupid);
+                    }
+                    break;
+                default:
+                    mixture.add_value(shared, groupid, rng() % 20, rng);
+            }
+        }
+
+        SnapshotWriter writer;
+        ids.snapshot_dump(writer, "ids.");
+        if (log.should_compact()) {
+            mixture.snapshot_dump(shared, writer, "mixture.");
+            log.write_base(writer);
+        } else {
+            mixture.snapshot_dump_delta(writer, "mixture.", ids);
+            log.write_delta(writer);
+            ++delta_count;
+        }
+        mixture.clear_changes();
+
+        const SnapshotLog replay(path);
+        Model::FastMixture loaded;
+        MixtureIdTracker loaded_ids;
+        {
+            SnapshotReader reader(replay.filename(0));
+            loaded.snapshot_load(shared, reader, "mixture.", rng);
+            loaded_ids.snapshot_load(reader, "ids.");
+        }
+        for (size_t i = 1; i <= replay.delta_count(); ++i) {
+            SnapshotReader reader(replay.filename(i));
+            MixtureIdTracker next_ids;
+            next_ids.snapshot_load(reader, "ids.");
+            loaded.snapshot_load_delta(
+                shared,
+                reader,
+                "mixture.",
+                loaded_ids,
+                next_ids,
+                rng);
+            loaded_ids = next_ids;
+        }
+        loaded.validate(shared);
+
+        const size_t group_count = mixture.groups().size();
+        DIST_ASSERT_EQ(loaded.groups().size(), group_count);
+        for (size_t groupid = 0; groupid < group_count; ++groupid) {
+            DIST_ASSERT_EQ(
+                loaded_ids.packed_to_global(groupid),
+                ids.packed_to_global(groupid));
+            const auto & expected = mixture.groups(groupid);
+            const auto & actual = loaded.groups(groupid);
+            DIST_ASSERT_EQ(actual.count, expected.count);
+            DIST_ASSERT_EQ(actual.sum, expected.sum);
+        }
+        // deltas are replayed by update_all, the live mixture incrementally
+        assert_same_scores(shared, loaded, mixture, rng, 1e-5);
+    }
+    DIST_ASSERT_LT(0, delta_count);
+    remove_log(path);
+}
+
+int main() {
+    test_snapshot<BetaBernoulli>();
+    test_snapshot<BetaNegativeBinomial>();
+    test_snapshot<DirichletDiscrete<16>>();
+    test_snapshot<GammaPoisson>();
+    test_snapshot<NormalInverseChiSq>();
+    test_snapshot_log();
+    return 0;
+}
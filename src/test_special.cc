@@ -0,0 +1,169 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <math.h>
+#include <vector>
+#include <distributions/common.hpp>
+#include <distributions/special.hpp>
+
+using namespace distributions;  // NOLINT(*)
+
+// error relative to 1 + |exact|, since exact crosses zero near x = 1, n = 1
+inline double mixed_error(double actual, double exact) {
+    return fabs(actual - exact) / (1 + fabs(exact));
+}
+
+void test_log_rising_factorial_error() {
+    const size_t ns[] = {0, 1, 2, 3, 7, 15, 16, 17, 100, 12345, 100000};
+    std::vector<float> xs;
+    std::vector<size_t> counts;
+    std::vector<double> expected;
+    for (double log_x = -2; log_x <= 4; log_x += 0.01) {
+        const float x = pow(10, log_x);
+        for (size_t n : ns) {
+            const double exact = lgamma(double(x) + n) - lgamma(double(x));
+            const double actual = log_rising_factorial(x, n);
+            DIST_ASSERT(mixed_error(actual, exact) < 1e-4,
+                "log_rising_factorial(" << x << ", " << n << ") = "
+                << actual << ", expected " << exact);
+            xs.push_back(x);
+            counts.push_back(n);
+            expected.push_back(exact);
+        }
+    }
+
+    std::vector<float> actual(xs.size());
+    vector_log_rising_factorial(
+        xs.size(),
+        xs.data(),
+        counts.data(),
+        actual.data());
+    for (size_t i = 0; i < xs.size(); ++i) {
+        DIST_ASSERT(mixed_error(actual[i], expected[i]) < 1e-4,
+            "vector_log_rising_factorial(" << xs[i] << ", " << counts[i]
+            << ") = " << actual[i] << ", expected " << expected[i]);
+    }
+
+    // products of huge factors must be renormalized after every factor
+    xs.clear();
+    counts.clear();
+    expected.clear();
+    for (float x : {1e10f, 1e20f, 1e30f, 1e38f}) {
+        for (size_t n = 0; n < 16; ++n) {
+            double exact = 0;
+            for (size_t i = 0; i < n; ++i) {
+                exact += log(double(x) + i);
+            }
+            xs.push_back(x);
+            counts.push_back(n);
+            expected.push_back(exact);
+        }
+    }
+    actual.resize(xs.size());
+    vector_log_rising_factorial(
+        xs.size(),
+        xs.data(),
+        counts.data(),
+        actual.data());
+    for (size_t i = 0; i < xs.size(); ++i) {
+        DIST_ASSERT(mixed_error(actual[i], expected[i]) < 1e-4,
+            "vector_log_rising_factorial(" << xs[i] << ", " << counts[i]
+            << ") = " << actual[i] << ", expected " << expected[i]);
+    }
+}
+
+void test_signed_log_rising_factorial() {
+    const float x = 2.5f;
+    for (count_t n = -2; n <= 20; ++n) {
+        const double exact = lgamma(double(x) + n) - lgamma(double(x));
+        const double actual = signed_log_rising_factorial(x, n);
+        DIST_ASSERT(mixed_error(actual, exact) < 1e-4,
+            "signed_log_rising_factorial(" << x << ", " << n << ") = "
+            << actual << ", expected " << exact);
+    }
+}
+
+void test_log_stirling1_row_view() {
+    std::vector<float> row;
+    for (size_t n = 0; n < log_stirling1_exact_row_count(); ++n) {
+        get_log_stirling1_row(n, row);
+        const float * view = log_stirling1_row_view(n);
+        for (size_t k = 0; k <= n; ++k) {
+            DIST_ASSERT(view[k] == row[k],
+                "log_stirling1_row_view(" << n << ")[" << k << "] = "
+                << view[k] << ", expected " << row[k]);
+        }
+    }
+}
+
+// tables must agree with log_rising_factorial, and tables for new offsets
+// must only be as large as their lookups repay
+void test_lgamma_offset_cache() {
+    LgammaOffsetCache cache;
+    const float offsets[] = {0.5f, 2.f, 2.5f};
+    const size_t row_count = 3;
+
+    const auto table = cache.get(offsets, row_count, 100, 3 * 1000);
+    DIST_ASSERT_EQ(table->size(), 100);
+    DIST_ASSERT(cache.get(offsets, row_count, 50, 3) == table,
+        "a matching table was rebuilt");
+
+    // offsets seen before get a full table, however few the lookups
+    DIST_ASSERT_EQ(cache.get(offsets, row_count, 500, 3)->size(), 500);
+
+    // changed offsets with too few lookups: no table, and the cache keeps
+    // the last one
+    const float other_offsets[] = {1.f, 3.f, 4.f};
+    const auto untabled = cache.get(other_offsets, row_count, 500, 2);
+    DIST_ASSERT_EQ(untabled->size(), 0);
+    DIST_ASSERT(cache.get(offsets, row_count, 500, 3)->matches(offsets, 3),
+        "an empty table replaced the cached one");
+    DIST_ASSERT_EQ(cache.get(other_offsets, row_count, 500, 30)->size(), 10);
+    DIST_ASSERT_EQ(cache.get(other_offsets, row_count, 500, 30)->size(), 500);
+
+    for (const auto & t : {table, untabled}) {
+        const float * t_offsets = t == table ? offsets : other_offsets;
+        for (size_t row = 0; row < row_count; ++row) {
+            for (size_t n : {0, 1, 10, 99, 100, 1000}) {
+                const double expected =
+                    log_rising_factorial(t_offsets[row], n);
+                const double actual = t->log_rising_factorial(row, n);
+                DIST_ASSERT(mixed_error(actual, expected) < 1e-5,
+                    "log_rising_factorial(" << t_offsets[row] << ", " << n
+                    << ") = " << actual << ", expected " << expected);
+            }
+        }
+    }
+}
+
+int main() {
+    test_log_rising_factorial_error();
+    test_signed_log_rising_factorial();
+    test_log_stirling1_row_view();
+    test_lgamma_offset_cache();
+    return 0;
+}
@@ -0,0 +1,160 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <distributions/common.hpp>
+#include <distributions/io/stream.hpp>
+
+using namespace distributions;  // NOLINT(*)
+
+const std::string filename = "test_stream.pbs";
+
+std::string read_file(const std::string & name) {
+    std::string result;
+    FILE * file = fopen(name.c_str(), "rb");
+    DIST_ASSERT(file, "failed to open " << name);
+    char buffer[4096];
+    while (size_t count = fread(buffer, 1, sizeof(buffer), file)) {
+        result.append(buffer, count);
+    }
+    fclose(file);
+    return result;
+}
+
+void write_file(const std::string & name, const std::string & data) {
+    FILE * file = fopen(name.c_str(), "wb");
+    DIST_ASSERT(file, "failed to open " << name);
+    DIST_ASSERT_EQ(fwrite(data.data(), 1, data.size(), file), data.size());
+    fclose(file);
+}
+
+// runs fun in a child process, which must die with an error
+template<class Fun>
+void assert_fails(const Fun & fun) {
+    const pid_t pid = fork();
+    DIST_ASSERT(pid != -1, "failed to fork");
+    if (pid == 0) {
+        fun();
+        _exit(0);
+    }
+    int status;
+    DIST_ASSERT_EQ(waitpid(pid, & status, 0), pid);
+    DIST_ASSERT(
+        not WIFEXITED(status) or WEXITSTATUS(status) != 0,
+        "expected failure");
+}
+
+std::vector<std::string> example_records() {
+    std::vector<std::string> records;
+    records.push_back("");
+    records.push_back("a");
+    records.push_back(std::string("\0\1\2\3", 4));
+    for (size_t size : {100, 1 << 16, 3 << 20}) {
+        std::string record(size, '\0');
+        for (size_t i = 0; i < size; ++i) {
+            record[i] = static_cast<char>(i * 7919 >> 3);
+        }
+        records.push_back(record);
+    }
+    return records;
+}
+
+void test_round_trip(const std::string & name, bool background) {
+    const auto records = example_records();
+    {
+        ProtobufStreamWriter writer(name);
+        for (const auto & record : records) {
+            writer.write_stream(record);
+        }
+        writer.close();
+    }
+    ProtobufStreamReader reader(name, background);
+    std::string record;
+    for (const auto & expected : records) {
+        DIST_ASSERT(reader.try_read_stream(record), "stream ended early");
+        DIST_ASSERT(record == expected, "record mismatch");
+    }
+    DIST_ASSERT(not reader.try_read_stream(record), "expected end of stream");
+    remove(name.c_str());
+}
+
+// byte layout of distributions/io/stream.py: little-endian uint32 sizes
+void test_python_format() {
+    const std::string expected("\3\0\0\0abc\0\0\0\0\1\1\0\0", 15);
+    {
+        ProtobufStreamWriter writer(filename);
+        writer.write_stream("abc");
+        writer.write_stream("");
+        writer.write_stream(std::string(257, 'x'));
+    }
+    const std::string actual = read_file(filename);
+    DIST_ASSERT_EQ(actual.size(), expected.size() + 257);
+    DIST_ASSERT(actual.compare(0, expected.size(), expected) == 0,
+        "header mismatch");
+
+    ProtobufStreamReader reader(filename, false);
+    std::string record;
+    DIST_ASSERT(reader.try_read_stream(record), "stream ended early");
+    DIST_ASSERT_EQ(record, "abc");
+    DIST_ASSERT(reader.try_read_stream(record), "stream ended early");
+    DIST_ASSERT_EQ(record, "");
+    DIST_ASSERT(reader.try_read_stream(record), "stream ended early");
+    DIST_ASSERT_EQ(record, std::string(257, 'x'));
+    DIST_ASSERT(not reader.try_read_stream(record), "expected end of stream");
+    remove(filename.c_str());
+}
+
+void test_truncation() {
+    const std::string record("\3\0\0\0abc", 7);
+    for (size_t size = 1; size < record.size(); ++size) {
+        write_file(filename, record + record.substr(0, size));
+        assert_fails([]() {
+            ProtobufStreamReader reader(filename, false);
+            std::string record;
+            while (reader.try_read_stream(record)) {}
+        });
+    }
+    remove(filename.c_str());
+}
+
+int main() {
+    test_round_trip(filename, false);
+    test_round_trip(filename, true);
+#ifdef USE_ZLIB
+    test_round_trip(filename + ".gz", true);
+#endif  // USE_ZLIB
+#ifdef USE_BZIP2
+    test_round_trip(filename + ".bz2", true);
+#endif  // USE_BZIP2
+    test_python_format();
+    test_truncation();
+    return 0;
+}
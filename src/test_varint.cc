@@ -0,0 +1,181 @@
+// Copyright (c) 2014, Salesforce.com, Inc.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//
+// - Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+// - Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+// - Neither the name of Salesforce.com nor the names of its contributors
+//   may be used to endorse or promote products derived from this
+//   software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE
+// COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+// INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+// BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+// OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR
+// TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <math.h>
+#include <stdint.h>
+#include <limits>
+#include <string>
+#include <vector>
+#include <distributions/common.hpp>
+#include <distributions/random.hpp>
+#include <distributions/io/varint.hpp>
+#include <distributions/models/dpd.hpp>
+
+using namespace distributions;  // NOLINT(*)
+
+void test_varint() {
+    const uint64_t values[] = {
+        0, 1, 127, 128, 300, 16383, 16384,
+        (uint64_t(1) << 32) - 1,
+        uint64_t(1) << 63,
+        std::numeric_limits<uint64_t>::max()};
+    const size_t sizes[] = {1, 1, 1, 2, 2, 2, 3, 5, 10, 10};
+    std::string out;
+    for (size_t i = 0; i < 10; ++i) {
+        const size_t begin = out.size();
+        varint_write(out, values[i]);
+        DIST_ASSERT_EQ(out.size() - begin, sizes[i]);
+    }
+    DIST_ASSERT_EQ(out.substr(5, 2), "\xAC\x02");  // as protobuf encodes 300
+
+    const char * pos = out.data();
+    const char * end = pos + out.size();
+    for (uint64_t value : values) {
+        DIST_ASSERT_EQ(varint_read(pos, end), value);
+    }
+    DIST_ASSERT(pos == end, "unread bytes");
+}
+
+void test_zigzag() {
+    DIST_ASSERT_EQ(zigzag_encode(0), 0);
+    DIST_ASSERT_EQ(zigzag_encode(-1), 1);
+    DIST_ASSERT_EQ(zigzag_encode(1), 2);
+    DIST_ASSERT_EQ(zigzag_encode(-2), 3);
+    const int64_t values[] = {
+        0, 1, -1, 63, -64, 64, -65,
+        std::numeric_limits<int64_t>::max(),
+        std::numeric_limits<int64_t>::min()};
+    for (int64_t value : values) {
+        DIST_ASSERT_EQ(zigzag_decode(zigzag_encode(value)), value);
+    }
+}
+
+void test_float() {
+    rng_t rng(0);
+    for (size_t i = 0; i < 1000; ++i) {
+        const float value = sample_unif01(rng) * pow(10, i % 13 - 6.0);
+        for (int byte_count : {2, 3, 4}) {
+            std::string out;
+            float_write(out, value, byte_count);
+            DIST_ASSERT_EQ(out.size(), size_t(byte_count));
+            const char * pos = out.data();
+            const float actual = float_read(pos, pos + out.size(), byte_count);
+            // rounding keeps 8 * byte_count - 9 mantissa bits
+            const float tol = ldexp(1.0f, 8 - 8 * byte_count) * value;
+            DIST_ASSERT_LE(fabs(actual - value), tol);
+            if (byte_count == 4) {
+                DIST_ASSERT_EQ(actual, value);
+            }
+        }
+    }
+}
+
+void test_dpd_compact() {
+    typedef DirichletProcessDiscrete Model;
+    rng_t rng(0);
+    const auto shared = Model::Shared::EXAMPLE();
+
+    std::string out;
+    shared.compact_dump(out);
+    Model::Shared exact;
+    exact.compact_load(out);
+    DIST_ASSERT_EQ(exact.gamma, shared.gamma);
+    DIST_ASSERT_EQ(exact.alpha, shared.alpha);
+    DIST_ASSERT_EQ(exact.betas.size(), shared.betas.size());
+    DIST_ASSERT_EQ(exact.counts.size(), shared.counts.size());
+    for (const auto & pair : shared.betas) {
+        DIST_ASSERT_EQ(exact.betas.get(pair.first), pair.second);
+        DIST_ASSERT_EQ(
+            exact.counts.get_count(pair.first),
+            shared.counts.get_count(pair.first));
+    }
+
+    // rounded betas must stay close and still sum to at most 1
+    for (int beta_bytes : {2, 3}) {
+        out.clear();
+        shared.compact_dump(out, beta_bytes);
+        Model::Shared rounded;
+        rounded.compact_load(out);
+        float beta_sum = rounded.beta0;
+        for (const auto & pair : shared.betas) {
+            const float beta = rounded.betas.get(pair.first);
+            DIST_ASSERT_LE(fabs(beta - pair.second), 1e-2f * pair.second);
+            beta_sum += beta;
+        }
+        DIST_ASSERT_LE(beta_sum, 1 + 1e-4);
+    }
+
+    // groups keep data debt, and their encoding does not depend on the
+    // order values were added in
+    Model::Group group;
+    Model::Group reversed;
+    group.init(shared, rng);
+    reversed.init(shared, rng);
+    std::vector<Model::Value> values;
+    for (const auto & pair : shared.betas) {
+        values.push_back(pair.first);
+    }
+    for (size_t i = 0; i < values.size(); ++i) {
+        for (size_t j = 0; j <= i % 5; ++j) {
+            group.add_value(shared, values[i], rng);
+        }
+    }
+    for (size_t i = values.size(); i--;) {
+        for (size_t j = 0; j <= i % 5; ++j) {
+            reversed.add_value(shared, values[i], rng);
+        }
+    }
+    group.remove_value(shared, values[0], rng);
+    group.remove_value(shared, values[0], rng);
+    reversed.remove_value(shared, values[0], rng);
+    reversed.remove_value(shared, values[0], rng);
+    DIST_ASSERT_EQ(group.counts.get_count(values[0]), -1);
+
+    std::string group_out;
+    std::string reversed_out;
+    group.compact_dump(group_out);
+    reversed.compact_dump(reversed_out);
+    DIST_ASSERT(group_out == reversed_out, "compact_dump is not canonical");
+
+    Model::Group loaded;
+    loaded.compact_load(group_out);
+    DIST_ASSERT_EQ(loaded.counts.size(), group.counts.size());
+    DIST_ASSERT_EQ(loaded.counts.get_total(), group.counts.get_total());
+    for (Model::Value value : values) {
+        DIST_ASSERT_EQ(
+            loaded.counts.get_count(value),
+            group.counts.get_count(value));
+    }
+}
+
+int main() {
+    test_varint();
+    test_zigzag();
+    test_float();
+    test_dpd_compact();
+    return 0;
+}